@@ -4,6 +4,7 @@
 
 #include <hppv/Renderer.hpp>
 #include <hppv/Texture.hpp>
+#include <hppv/TextureLoader.hpp>
 #include <hppv/Shader.hpp>
 #include <hppv/imgui.h>
 
@@ -15,12 +16,13 @@
 class GLTransitions: public hppv::Scene
 {
 public:
-    GLTransitions():
-        tex1_("res/mononoke.jpg"),
-        tex2_("res/laputa.jpg")
+    GLTransitions()
     {
         properties_.maximize = true;
 
+        loader_.load(tex1_, "res/mononoke.jpg");
+        loader_.load(tex2_, "res/laputa.jpg");
+
         addShader(burn, "burn");
         addShader(heart, "heart");
         addShader(cube, "cube");
@@ -37,7 +39,9 @@ public:
     }
 
 private:
+    // green pixels until loaded
     hppv::Texture tex1_, tex2_;
+    hppv::TextureLoader loader_;
     hppv::Texture* texFrom_ = &tex1_;
     hppv::Texture* texTo_ = &tex2_;
     std::vector<hppv::Shader> shaders_;
@@ -64,6 +68,8 @@ private:
 
     void render(hppv::Renderer& renderer) override
     {
+        loader_.update();
+
         transition_.progressTime += frame_.time;
 
         ImGui::Begin("transition");
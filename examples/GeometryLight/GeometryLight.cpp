@@ -12,7 +12,6 @@
 #include <hppv/Renderer.hpp>
 #include <hppv/imgui.h>
 #include <hppv/Shader.hpp>
-#include <hppv/Framebuffer.hpp>
 #include <hppv/glad.h>
 
 #include "../run.hpp"
@@ -23,11 +22,8 @@ const char* const lightSource = R"(
 #version 330
 
 in vec4 vColor;
-in vec2 vTexCoord;
 in vec2 vPos;
 
-uniform sampler2D sampler;
-
 const float radius = 0.5;
 const vec2 center = vec2(0.5, 0.5);
 
@@ -37,8 +33,7 @@ void main()
 {
     float distanceFromCenter = length(vPos - center);
     float alpha = 1.0 - smoothstep(0.0, radius, distanceFromCenter);
-    vec4 sample = texture(sampler, vTexCoord);
-    color = sample * vColor * alpha;
+    color = vColor * alpha;
 }
 )";
 
@@ -86,8 +81,7 @@ class GeometryLight: public hppv::Prototype
 public:
     GeometryLight():
         hppv::Prototype({0.f, 0.f, 100.f, 100.f}),
-        shaderLight_({hppv::Renderer::vInstancesSource, lightSource}, "shaderLight_"),
-        fb_(GL_RGBA8, 1)
+        shaderLight_({hppv::Renderer::vInstancesSource, lightSource}, "shaderLight_")
     {
         setShapes();
     }
@@ -98,7 +92,6 @@ private:
     std::vector<glm::vec2> points_;
     glm::vec2 lightPos_;
     hppv::Shader shaderLight_;
-    hppv::Framebuffer fb_;
 
     struct
     {
@@ -183,12 +176,10 @@ private:
         }
         ImGui::End();
 
+        // the visibility polygon clips the light
         if(options_.release)
         {
-            fb_.bind();
-            fb_.setSize(properties_.size);
-            fb_.clear();
-            renderer.viewport(fb_);
+            renderer.stencilWrite();
         }
 
         if(options_.drawTriangles || options_.release)
@@ -201,17 +192,9 @@ private:
             {
                 const auto last = (it == points_.end() - 1) ? *points_.begin() : *(it + 1);
 
+                // in release the triangles only write the stencil, the color is for the debug view
                 hppv::Vertex v;
-
-                if(options_.release)
-                {
-                    v.color = {1.f, 0.f, 0.f, 1.f};
-                }
-                else
-                {
-                    v.color = {0.3f, 0.f, 0.f, 1.f};
-                }
-
+                v.color = {0.3f, 0.f, 0.f, 1.f};
                 v.pos = lightPos_;
                 renderer.cache(v);
                 v.pos = *it;
@@ -223,22 +206,17 @@ private:
 
         if(options_.release)
         {
-            renderer.flush();
-            renderer.viewport(this);
-            fb_.unbind();
-
+            renderer.stencilTest();
             renderer.mode(hppv::RenderMode::Instances);
-            renderer.normalizeTexRect = true;
 
             hppv::Circle c;
             c.center = lightPos_;
-            c.radius = border_.size.x * 0.65f;;
-            c.texRect = hppv::mapToFramebuffer(c.toVec4(), space_.projected, fb_);
+            c.radius = border_.size.x * 0.65f;
+            c.color = {1.f, 0.f, 0.f, 1.f};
 
             renderer.shader(shaderLight_);
-            renderer.texture(fb_.getTexture());
             renderer.cache(c);
-            renderer.normalizeTexRect = false;
+            renderer.disableStencil();
         }
 
         renderer.mode(hppv::RenderMode::Vertices);
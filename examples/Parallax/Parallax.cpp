@@ -6,7 +6,7 @@
 #include <glm/geometric.hpp> // glm::normalize
 
 #include <hppv/Renderer.hpp>
-#include <hppv/Texture.hpp>
+#include <hppv/TextureAtlas.hpp>
 #include <hppv/imgui.h>
 
 #include "../run.hpp"
@@ -14,7 +14,6 @@
 struct Layer
 {
     hppv::Space space;
-    hppv::Texture texture;
     float moveCoeff;
     hppv::Sprite sprite;
 };
@@ -22,26 +21,26 @@ struct Layer
 class Parallax: public hppv::Scene
 {
 public:
-    Parallax()
+    Parallax():
+        // 272 x 160 each, all on one page, so all the layers are rendered in one batch
+        atlas_({"res/parallax-forest-back-trees.png",
+                "res/parallax-forest-lights.png",
+                "res/parallax-forest-middle-trees.png",
+                "res/parallax-forest-front-trees.png"}, {1024, 512})
     {
         properties_.maximize = true;
 
-        layers_[0].texture = hppv::Texture("res/parallax-forest-back-trees.png");
         layers_[0].moveCoeff = 0.05f;
-
-        layers_[1].texture = hppv::Texture("res/parallax-forest-lights.png");
         layers_[1].moveCoeff = 0.06f;
-
-        layers_[2].texture = hppv::Texture("res/parallax-forest-middle-trees.png");
         layers_[2].moveCoeff = 0.3f;
-
-        layers_[3].texture = hppv::Texture("res/parallax-forest-front-trees.png");
         layers_[3].moveCoeff = 1.f;
 
-        for(auto& layer: layers_)
+        for(auto i = 0; i < NumLayers; ++i)
         {
-            layer.space = hppv::Space(0, 0, layers_[0].texture.getSize());
-            layer.sprite = hppv::Sprite(layer.space);
+            auto& layer = layers_[i];
+            layer.space = hppv::Space(0, 0, atlas_.getImage(0).size);
+            layer.sprite = hppv::Sprite(atlas_.getImage(i));
+            layer.sprite.pos = {0.f, 0.f};
         }
     }
 
@@ -49,7 +48,10 @@ public:
     void render(hppv::Renderer& renderer) override;
 
 private:
-    Layer layers_[4];
+    enum {NumLayers = 4};
+
+    hppv::TextureAtlas atlas_;
+    Layer layers_[NumLayers];
     std::set<int> keysHeld_;
     static inline float spaceVel_ = 200.f;
     static inline float zoomFactor_ = 1.1f;
@@ -139,13 +141,17 @@ void Parallax::render(hppv::Renderer& renderer)
     renderer.shader(hppv::Render::Tex);
     renderer.premultiplyAlpha(true);
 
+    // the layer spaces differ only in pos.x (the same zoom is applied to all of them),
+    // every layer is shifted into the space of the first one, so one projection is enough
+    const auto& baseSpace = layers_[0].space;
+    renderer.projection(hppv::expandToMatchAspectRatio(baseSpace, properties_.size));
+    renderer.texture(atlas_.getPage(0));
+
     for(auto& layer: layers_)
     {
+        const auto shift = layer.space.pos.x - baseSpace.pos.x;
         const auto projection = hppv::expandToMatchAspectRatio(layer.space, properties_.size);
 
-        renderer.projection(projection);
-        renderer.texture(layer.texture);
-
         const auto d = projection.pos.x - layer.sprite.pos.x;
         float x = projection.pos.x;
 
@@ -163,7 +169,7 @@ void Parallax::render(hppv::Renderer& renderer)
         while(x < projection.pos.x + projection.size.x)
         {
             auto sprite = layer.sprite;
-            sprite.pos.x = x;
+            sprite.pos.x = x - shift;
             renderer.cache(sprite);
             x += sprite.size.x;
         }
@@ -1,12 +1,17 @@
-#include <algorithm> // std::min, std::swap
+#include <algorithm> // std::min
 
 #include <hppv/glad.h>
+#include <hppv/App.hpp>
 
 #include "Emitter.hpp"
 
 void Emitter::reserveMemory()
 {
-    particles_.reserve(life.max * spawn.hz);
+    for(auto& channel: channels_)
+    {
+        channel.reserve(life.max * spawn.hz);
+    }
+
     circles_.reserve(life.max * spawn.hz);
 }
 
@@ -14,103 +19,202 @@ void Emitter::update(float frameTime)
 {
     frameTime = std::min(frameTime, 0.020f); // useful when debugging
 
-    for(std::size_t i = 0; i < count_; ++i)
-    {
-        particles_[i].life -= frameTime;
+    auto& jobs = hppv::App::getJobs();
 
-        if(particles_[i].life <= 0.f)
-        {
-            killParticle(i); // note: swap()
-        }
+    jobs.parallelFor(count_, [this, frameTime](const int first, const int last)
+    {
+        integrate(frameTime, first, last);
+    },
+    ChunkSize);
 
-        // note: acceleration is constant
-        circles_[i].center += particles_[i].acc * frameTime * frameTime * 0.5f + particles_[i].vel * frameTime;
-        particles_[i].vel += particles_[i].acc * frameTime;
-        circles_[i].color += particles_[i].colorVel * frameTime;
-    }
+    removeDead();
 
     accumulator_ += frameTime;
 
     const auto spawnDelay = 1.f / spawn.hz;
+    const std::size_t numToSpawn = accumulator_ / spawnDelay;
+    accumulator_ -= numToSpawn * spawnDelay;
 
-    while(accumulator_ >= spawnDelay)
+    if(numToSpawn == 0)
     {
-        spawnParticle();
-        accumulator_ -= spawnDelay;
+        return;
     }
+
+    const auto start = count_;
+    count_ += numToSpawn;
+
+    if(count_ > channels_[0].size())
+    {
+        for(auto& channel: channels_)
+        {
+            channel.resize(count_);
+        }
+    }
+
+    jobs.parallelFor(numToSpawn, [this, start](const int first, const int last)
+    {
+        spawnParticles(start + first, start + last, numSpawned_ + first);
+    },
+    ChunkSize);
+
+    numSpawned_ += numToSpawn;
 }
 
 void Emitter::render(hppv::Renderer& renderer)
 {
+    circles_.resize(count_);
+
+    hppv::App::getJobs().parallelFor(count_, [this](const int first, const int last)
+    {
+        const auto* const posX = get(PosX);
+        const auto* const posY = get(PosY);
+        const auto* const radius = get(Radius);
+        const auto* const colorR = get(ColorR);
+        const auto* const colorG = get(ColorG);
+        const auto* const colorB = get(ColorB);
+        const auto* const colorA = get(ColorA);
+
+        for(auto i = first; i < last; ++i)
+        {
+            auto& circle = circles_[i];
+            circle.center = {posX[i], posY[i]};
+            circle.radius = radius[i];
+            circle.color = {colorR[i], colorG[i], colorB[i], colorA[i]};
+        }
+    },
+    ChunkSize);
+
     renderer.blend(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
     renderer.shader(hppv::Render::CircleColor);
     renderer.cache(circles_.data(), count_);
 }
 
-void Emitter::killParticle(const std::size_t index)
+// one stream (or three) per loop, they are simple enough to be auto-vectorized
+
+void integrateAxis(float* const pos, float* const vel, const float* const acc, const std::size_t count,
+                   const float dt)
 {
-    std::swap(particles_[index], particles_[count_ - 1]);
-    std::swap(circles_[index], circles_[count_ - 1]);
-    --count_;
+    const auto halfDt2 = dt * dt * 0.5f;
+
+    // note: acceleration is constant
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        pos[i] += acc[i] * halfDt2 + vel[i] * dt;
+        vel[i] += acc[i] * dt;
+    }
 }
 
-void Emitter::spawnParticle()
+void addScaled(float* const dst, const float* const src, const std::size_t count, const float scale)
 {
-    if(count_ + 1 > particles_.size())
+    for(std::size_t i = 0; i < count; ++i)
     {
-        particles_.emplace_back();
-        circles_.emplace_back();
+        dst[i] += src[i] * scale;
     }
+}
+
+void Emitter::integrate(const float frameTime, const std::size_t first, const std::size_t last)
+{
+    const auto count = last - first;
 
-    Particle p;
-    hppv::Circle c;
+    integrateAxis(get(PosX) + first, get(VelX) + first, get(AccX) + first, count, frameTime);
+    integrateAxis(get(PosY) + first, get(VelY) + first, get(AccY) + first, count, frameTime);
 
-    // center
-    {
-        Distribution d(0.f, 1.f);
-        c.center = spawn.pos + glm::vec2(d(*generator) * spawn.size.x, d(*generator) * spawn.size.y);
-    }
-    // radius
+    for(auto i = 0; i < 4; ++i)
     {
-        Distribution d(radius.min, radius.max);
-        c.radius = d(*generator);
+        addScaled(get(Channel(ColorR + i)) + first, get(Channel(ColorVelR + i)) + first, count, frameTime);
     }
-    // life
+
+    auto* const life = get(Life);
+
+    for(auto i = first; i < last; ++i)
     {
-        Distribution d(life.min, life.max);
-        p.life = d(*generator);
+        life[i] -= frameTime;
     }
-    // color
-    {
-        Distribution dSR(colorStart.min.r, colorStart.max.r);
-        Distribution dSG(colorStart.min.g, colorStart.max.g);
-        Distribution dSB(colorStart.min.b, colorStart.max.b);
-        Distribution dSA(colorStart.min.a, colorStart.max.a);
+}
+
+// the last alive particle takes the place of the dead one (only a few die every frame)
+void Emitter::removeDead()
+{
+    const auto* const life = get(Life);
 
-        Distribution dER(colorEnd.min.r, colorEnd.max.r);
-        Distribution dEG(colorEnd.min.g, colorEnd.max.g);
-        Distribution dEB(colorEnd.min.b, colorEnd.max.b);
-        Distribution dEA(colorEnd.min.a, colorEnd.min.a);
+    for(std::size_t i = 0; i < count_;)
+    {
+        if(life[i] > 0.f)
+        {
+            ++i;
+            continue;
+        }
 
-        c.color = glm::vec4(dSR(*generator), dSG(*generator), dSB(*generator), dSA(*generator));
+        --count_;
 
-        p.colorVel = (glm::vec4(dER(*generator), dEG(*generator), dEB(*generator), dEA(*generator))
-                      - c.color) / p.life;
+        for(auto& channel: channels_)
+        {
+            channel[i] = channel[count_];
+        }
     }
-    // vel
+}
+
+// Philox4x32-10 (Salmon et al., Parallel Random Numbers: As Easy as 1, 2, 3)
+void philox(std::uint32_t (&counter)[4], std::uint32_t key0, std::uint32_t key1)
+{
+    for(auto round = 0; round < 10; ++round)
     {
-        Distribution dX(vel.min.x, vel.max.x);
-        Distribution dY(vel.min.y, vel.max.y);
-        p.vel = glm::vec2(dX(*generator), dY(*generator));
+        const auto p0 = std::uint64_t(0xD2511F53) * counter[0];
+        const auto p1 = std::uint64_t(0xCD9E8D57) * counter[2];
+
+        counter[0] = std::uint32_t(p1 >> 32) ^ counter[1] ^ key0;
+        counter[1] = std::uint32_t(p1);
+        counter[2] = std::uint32_t(p0 >> 32) ^ counter[3] ^ key1;
+        counter[3] = std::uint32_t(p0);
+
+        key0 += 0x9E3779B9;
+        key1 += 0xBB67AE85;
     }
-    // acc
+}
+
+void Emitter::spawnParticles(const std::size_t first, const std::size_t last, std::uint64_t spawnNumber)
+{
+    const auto key0 = std::uint32_t(seed);
+    const auto key1 = std::uint32_t(seed >> 32);
+
+    for(auto i = first; i < last; ++i, ++spawnNumber)
     {
-        Distribution dX(acc.min.x, acc.max.x);
-        Distribution dY(acc.min.y, acc.max.y);
-        p.acc = glm::vec2(dX(*generator), dY(*generator));
-    }
+        float r[16]; // [0, 1)
+
+        for(auto block = 0u; block < 4; ++block)
+        {
+            std::uint32_t counter[4] = {std::uint32_t(spawnNumber), std::uint32_t(spawnNumber >> 32), block, 0};
+            philox(counter, key0, key1);
+
+            for(auto j = 0; j < 4; ++j)
+            {
+                r[block * 4 + j] = (counter[j] >> 8) * (1.f / (1 << 24));
+            }
+        }
 
-    particles_[count_] = p;
-    circles_[count_] = c;
-    ++count_;
+        const auto lerp = [](const float min, const float max, const float r)
+        {
+            return min + (max - min) * r;
+        };
+
+        get(PosX)[i] = lerp(spawn.pos.x, spawn.pos.x + spawn.size.x, r[0]);
+        get(PosY)[i] = lerp(spawn.pos.y, spawn.pos.y + spawn.size.y, r[1]);
+        get(VelX)[i] = lerp(vel.min.x, vel.max.x, r[2]);
+        get(VelY)[i] = lerp(vel.min.y, vel.max.y, r[3]);
+        get(AccX)[i] = lerp(acc.min.x, acc.max.x, r[4]);
+        get(AccY)[i] = lerp(acc.min.y, acc.max.y, r[5]);
+        get(Radius)[i] = lerp(radius.min, radius.max, r[6]);
+
+        const auto particleLife = lerp(life.min, life.max, r[7]);
+        get(Life)[i] = particleLife;
+
+        for(auto c = 0; c < 4; ++c)
+        {
+            const auto start = lerp(colorStart.min[c], colorStart.max[c], r[8 + c]);
+            const auto end = lerp(colorEnd.min[c], colorEnd.max[c], r[12 + c]);
+
+            get(Channel(ColorR + c))[i] = start;
+            get(Channel(ColorVelR + c))[i] = (end - start) / particleLife;
+        }
+    }
 }
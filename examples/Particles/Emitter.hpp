@@ -1,6 +1,6 @@
 #pragma once
 
-#include <random>
+#include <cstdint>
 #include <vector>
 
 #include <hppv/Renderer.hpp>
@@ -12,13 +12,14 @@ struct Range
     T max;
 };
 
+// the particles are updated and spawned with App::getJobs(), the random values
+// depend only on the seed and the spawn number (Philox4x32-10), so the simulation
+// does not depend on the number of threads
+
 class Emitter
 {
 public:
-    using Distribution = std::uniform_real_distribution<float>;
-
-    Emitter(std::mt19937* generator): generator(generator) {}
-    Emitter(std::mt19937& generator): generator(&generator) {}
+    explicit Emitter(std::uint64_t seed): seed(seed) {}
 
     void reserveMemory(); // based on life and spawn.hz
 
@@ -28,7 +29,7 @@ public:
 
     std::size_t getCount() const {return count_;}
 
-    std::mt19937* generator;
+    std::uint64_t seed;
 
     struct
     {
@@ -46,19 +47,31 @@ public:
     Range<glm::vec4> colorEnd;
 
 private:
-    struct Particle
+    // structure of arrays, so the update loops can be vectorized
+    enum Channel
     {
-        float life;
-        glm::vec4 colorVel;
-        glm::vec2 vel;
-        glm::vec2 acc;
+        PosX, PosY,
+        VelX, VelY,
+        AccX, AccY,
+        Radius,
+        Life,
+        ColorR, ColorG, ColorB, ColorA,
+        ColorVelR, ColorVelG, ColorVelB, ColorVelA,
+        NumChannels
     };
 
-    std::vector<Particle> particles_;
-    std::vector<hppv::Circle> circles_;
+    // parallelFor(), a smaller chunk is not worth the scheduling
+    enum {ChunkSize = 4096};
+
+    std::vector<float> channels_[NumChannels]; // [0, count_) are alive
+    std::vector<hppv::Circle> circles_; // filled in render()
     std::size_t count_ = 0;
+    std::uint64_t numSpawned_ = 0; // the counter of the random generator
     float accumulator_ = 0.f;
 
-    void killParticle(std::size_t index);
-    void spawnParticle();
+    float* get(Channel channel) {return channels_[channel].data();}
+
+    void integrate(float frameTime, std::size_t first, std::size_t last);
+    void removeDead();
+    void spawnParticles(std::size_t first, std::size_t last, std::uint64_t spawnNumber); // of the first
 };
@@ -1,3 +1,5 @@
+#include <random>
+
 #include <hppv/Prototype.hpp>
 #include <hppv/imgui.h>
 
@@ -11,18 +13,15 @@ class Particles: public hppv::Prototype
 public:
     Particles():
         hppv::Prototype({0.f, 0.f, 1000.f, 1000.f}),
-        emitter_(generator_)
+        emitter_(std::random_device()())
     {
         prototype_.alwaysZoomToCursor = false;
 
-        std::random_device rd;
-        generator_.seed(rd());
         configureEmitter();
         emitter_.reserveMemory();
     }
 
 private:
-    std::mt19937 generator_;
     Emitter emitter_;
 
     void prototypeRender(hppv::Renderer& renderer) override
@@ -33,6 +32,7 @@ private:
         ImGui::Begin(prototype_.imguiWindowName);
         {
             ImGui::Text("count: %lu", emitter_.getCount());
+            ImGui::Text("threads: %d", hppv::App::getJobs().getNumThreads());
             ImGui::SliderInt("spawn.hz", &emitter_.spawn.hz, 60, 100000);
         }
         ImGui::End();
@@ -7,7 +7,7 @@
 
 #include <hppv/Prototype.hpp>
 #include <hppv/Renderer.hpp>
-#include <hppv/Framebuffer.hpp>
+#include <hppv/FramebufferPool.hpp>
 #include <hppv/Shader.hpp>
 #include <hppv/glad.h>
 
@@ -102,8 +102,6 @@ public:
 
     PixelShadows():
         hppv::Prototype({0.f, 0.f, 100.f, 100.f}),
-        fbOcclusion_(GL_RGBA8, 1),
-        fbShadow_(GL_RGBA8, 1),
         texTile_("res/tile.png"),
         shShadow_({hppv::Renderer::vInstancesSource, shadowSource}, "shShadow_"),
         shLight_({hppv::Renderer::vInstancesSource, lightSource}, "shLight_")
@@ -157,7 +155,7 @@ public:
 private:
     enum {LightRays = 256};
 
-    hppv::Framebuffer fbOcclusion_, fbShadow_;
+    hppv::FramebufferPool fbPool_;
     hppv::Texture texTile_;
     hppv::Shader shShadow_, shLight_;
     std::vector<hppv::Circle> lights_;
@@ -171,14 +169,18 @@ private:
 
         renderer.antialiasedSprites(true);
 
+        fbPool_.nextFrame();
+
         for(const auto& light: lights_)
         {
+            auto& fbOcclusion = fbPool_.acquire(GL_RGBA8, glm::ivec2(LightRays));
+            auto& fbShadow = fbPool_.acquire(GL_RGBA8, {LightRays, 1});
+
             // occlusion map
             {
-                fbOcclusion_.bind();
-                fbOcclusion_.setSize(glm::ivec2(LightRays));
-                fbOcclusion_.clear();
-                renderer.viewport(fbOcclusion_);
+                fbOcclusion.bind();
+                fbOcclusion.clear();
+                renderer.viewport(fbOcclusion);
                 renderer.projection(light.toSpace());
                 {
                     renderer.shader(hppv::Render::Color);
@@ -193,20 +195,19 @@ private:
             }
             // shadow map
             {
-                fbShadow_.bind();
-                fbShadow_.setSize({LightRays, 1});
-                fbShadow_.clear();
-                renderer.viewport(fbShadow_);
+                fbShadow.bind();
+                fbShadow.clear();
+                renderer.viewport(fbShadow);
                 {
                     hppv::Sprite sprite(space_.projected);
 
                     renderer.shader(shShadow_);
-                    renderer.texture(fbOcclusion_.getTexture());
+                    renderer.texture(fbOcclusion.getTexture());
                     renderer.cache(sprite);
                 }
                 renderer.flush();
                 renderer.viewport(this);
-                fbShadow_.unbind();
+                fbShadow.unbind();
             }
             // light
             {
@@ -215,11 +216,15 @@ private:
 
                 renderer.flipTextureY(true); // why?
                 renderer.shader(shLight_);
-                renderer.texture(fbShadow_.getTexture());
+                renderer.texture(fbShadow.getTexture());
                 renderer.cache(sprite);
                 renderer.flipTextureY(false);
                 renderer.flush();
             }
+
+            // the next light can reuse them
+            fbPool_.release(fbOcclusion);
+            fbPool_.release(fbShadow);
         }
 
         // objects
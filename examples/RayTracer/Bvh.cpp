@@ -0,0 +1,161 @@
+#include <numeric> // std::iota
+#include <algorithm> // std::partition
+
+#include "Bvh.hpp"
+
+static_assert(sizeof(Bvh::Node) == 32);
+
+Bvh::Bvh(const std::vector<Aabb>& bounds)
+{
+    const int count = bounds.size();
+
+    if(count == 0)
+        return;
+
+    Build build{bounds, {}};
+    build.centroids.reserve(count);
+
+    for(const auto& aabb: bounds)
+    {
+        build.centroids.push_back((aabb.min + aabb.max) * 0.5f);
+    }
+
+    indices_.resize(count);
+    std::iota(indices_.begin(), indices_.end(), 0);
+
+    nodes_.reserve(count * 2);
+    nodes_.emplace_back();
+    subdivide(build, 0, 0, count, 1);
+}
+
+// the cost of a node traversal == the cost of a primitive intersection
+void Bvh::subdivide(Build& build, const int nodeIndex, const int first, const int count, const int depth)
+{
+    depth_ = std::max(depth_, depth);
+
+    Aabb bounds, centroidBounds;
+
+    for(auto i = first; i < first + count; ++i)
+    {
+        bounds.extend(build.bounds[indices_[i]]);
+        centroidBounds.extend(build.centroids[indices_[i]]);
+    }
+
+    {
+        auto& node = nodes_[nodeIndex];
+        node.boundsMin = bounds.min;
+        node.boundsMax = bounds.max;
+        node.first = first;
+        node.count = count;
+    }
+
+    if(count == 1 || depth == MaxDepth)
+        return;
+
+    struct
+    {
+        int axis = -1;
+        int bin;
+        float cost = std::numeric_limits<float>::infinity();
+    }
+    best;
+
+    for(auto axis = 0; axis < 3; ++axis)
+    {
+        const auto min = centroidBounds.min[axis];
+        const auto extent = centroidBounds.max[axis] - min;
+
+        if(extent <= 0.f)
+            continue;
+
+        struct
+        {
+            Aabb bounds;
+            int count = 0;
+        }
+        bins[NumBins];
+
+        const auto scale = NumBins / extent;
+
+        for(auto i = first; i < first + count; ++i)
+        {
+            const auto idx = indices_[i];
+            const auto bin = std::min(static_cast<int>((build.centroids[idx][axis] - min) * scale), NumBins - 1);
+            bins[bin].bounds.extend(build.bounds[idx]);
+            ++bins[bin].count;
+        }
+
+        // the cost of splitting before bin i
+        float leftCosts[NumBins];
+        Aabb leftBounds;
+        auto leftCount = 0;
+
+        for(auto i = 1; i < NumBins; ++i)
+        {
+            leftBounds.extend(bins[i - 1].bounds);
+            leftCount += bins[i - 1].count;
+            leftCosts[i] = leftBounds.getArea() * leftCount;
+        }
+
+        Aabb rightBounds;
+        auto rightCount = 0;
+
+        for(auto i = NumBins - 1; i > 0; --i)
+        {
+            rightBounds.extend(bins[i].bounds);
+            rightCount += bins[i].count;
+
+            if(rightCount == 0 || rightCount == count)
+                continue;
+
+            const auto cost = leftCosts[i] + rightBounds.getArea() * rightCount;
+
+            if(cost < best.cost)
+            {
+                best.axis = axis;
+                best.bin = i;
+                best.cost = cost;
+            }
+        }
+    }
+
+    int numLeft;
+
+    if(best.axis == -1) // all the centroids are in one point
+    {
+        if(count <= MaxLeafSize)
+            return;
+
+        numLeft = count / 2;
+    }
+    else
+    {
+        const auto leafCost = static_cast<float>(count);
+        const auto splitCost = 1.f + best.cost / bounds.getArea();
+
+        if(splitCost >= leafCost && count <= MaxLeafSize)
+            return;
+
+        const auto axis = best.axis;
+        const auto min = centroidBounds.min[axis];
+        const auto scale = NumBins / (centroidBounds.max[axis] - min);
+
+        const auto middle = std::partition(indices_.begin() + first, indices_.begin() + first + count,
+                                           [&build, axis, min, scale, &best](const int idx)
+        {
+            return std::min(static_cast<int>((build.centroids[idx][axis] - min) * scale), NumBins - 1) < best.bin;
+        });
+
+        numLeft = middle - (indices_.begin() + first);
+    }
+
+    const int left = nodes_.size();
+    nodes_.emplace_back();
+    nodes_.emplace_back();
+
+    nodes_[nodeIndex].first = left;
+    nodes_[nodeIndex].count = 0;
+
+    subdivide(build, left, first, numLeft, depth + 1);
+    subdivide(build, left + 1, first + numLeft, count - numLeft, depth + 1);
+}
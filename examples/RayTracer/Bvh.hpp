@@ -0,0 +1,181 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <utility> // std::swap
+
+#include <glm/vec3.hpp>
+#include <glm/common.hpp> // glm::min, glm::max
+
+struct Aabb
+{
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::infinity());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::infinity());
+
+    void extend(const glm::vec3 point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void extend(const Aabb& aabb)
+    {
+        min = glm::min(min, aabb.min);
+        max = glm::max(max, aabb.max);
+    }
+
+    // 0 if empty
+    float getArea() const
+    {
+        const auto d = glm::max(max - min, 0.f);
+        return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+};
+
+// bounding volume hierarchy, built with the binned surface area heuristic
+//
+// the nodes are stored in one array, the children of a node are adjacent,
+// the traversal visits the nearer child first and keeps the farther one on a small stack
+
+class Bvh
+{
+public:
+    enum
+    {
+        MaxLeafSize = 4,
+        NumBins = 16,
+        MaxDepth = 64 // the size of the traversal stack
+    };
+
+    // 32 bytes, two in a cache line
+    struct Node
+    {
+        glm::vec3 boundsMin;
+        int first; // inner node - the left child (the right one is first + 1), leaf - the first index
+        glm::vec3 boundsMax;
+        int count; // 0 - inner node
+    };
+
+    Bvh() = default;
+
+    // bounds of the primitives, the primitive index is the position in the vector
+    explicit Bvh(const std::vector<Aabb>& bounds);
+
+    // calls intersect(index, closest) for the primitives the ray might hit before closest,
+    // intersect() returns true and decreases closest on a hit, returns true if any did
+    template<typename F>
+    bool intersect(glm::vec3 origin, glm::vec3 dir, float& closest, const F& intersect) const;
+
+    const std::vector<Node>& getNodes() const {return nodes_;}
+
+    // the primitive indices referenced by the leaves
+    const std::vector<int>& getIndices() const {return indices_;}
+
+    int getDepth() const {return depth_;}
+
+private:
+    struct Build
+    {
+        const std::vector<Aabb>& bounds;
+        std::vector<glm::vec3> centroids;
+    };
+
+    std::vector<Node> nodes_;
+    std::vector<int> indices_;
+    int depth_ = 0;
+
+    void subdivide(Build& build, int nodeIndex, int first, int count, int depth);
+
+    // returns the entry distance, infinity on a miss or if not closer than closest
+    static float intersectNode(const Node& node, glm::vec3 origin, glm::vec3 invDir, float closest);
+};
+
+inline float Bvh::intersectNode(const Node& node, const glm::vec3 origin, const glm::vec3 invDir, const float closest)
+{
+    const auto t1 = (node.boundsMin - origin) * invDir;
+    const auto t2 = (node.boundsMax - origin) * invDir;
+    const auto tMin = glm::min(t1, t2);
+    const auto tMax = glm::max(t1, t2);
+
+    const auto entry = glm::max(glm::max(tMin.x, tMin.y), glm::max(tMin.z, 0.f));
+    const auto exit = glm::min(glm::min(tMax.x, tMax.y), tMax.z);
+
+    if(entry > exit || entry >= closest)
+        return std::numeric_limits<float>::infinity();
+
+    return entry;
+}
+
+template<typename F>
+bool Bvh::intersect(const glm::vec3 origin, const glm::vec3 dir, float& closest, const F& intersect) const
+{
+    if(nodes_.empty())
+        return false;
+
+    const auto invDir = 1.f / dir;
+    constexpr auto miss = std::numeric_limits<float>::infinity();
+
+    if(intersectNode(nodes_[0], origin, invDir, closest) == miss)
+        return false;
+
+    struct
+    {
+        int node;
+        float entry;
+    }
+    stack[MaxDepth];
+
+    auto stackSize = 0;
+    auto nodeIndex = 0;
+    auto hit = false;
+
+    while(true)
+    {
+        const auto& node = nodes_[nodeIndex];
+
+        if(node.count)
+        {
+            for(auto i = node.first; i < node.first + node.count; ++i)
+            {
+                hit |= intersect(indices_[i], closest);
+            }
+        }
+        else
+        {
+            auto near = node.first;
+            auto far = node.first + 1;
+            auto entryNear = intersectNode(nodes_[near], origin, invDir, closest);
+            auto entryFar = intersectNode(nodes_[far], origin, invDir, closest);
+
+            if(entryFar < entryNear)
+            {
+                std::swap(near, far);
+                std::swap(entryNear, entryFar);
+            }
+
+            if(entryNear != miss)
+            {
+                if(entryFar != miss)
+                {
+                    stack[stackSize++] = {far, entryFar};
+                }
+
+                nodeIndex = near;
+                continue;
+            }
+        }
+
+        // the farther nodes might be already behind the closest hit
+        while(stackSize && stack[stackSize - 1].entry >= closest)
+        {
+            --stackSize;
+        }
+
+        if(stackSize == 0)
+            break;
+
+        nodeIndex = stack[--stackSize].node;
+    }
+
+    return hit;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sstream>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <hppv/Deleter.hpp>
+
+#include "../src/stb_image.h"
+#include "renderImage.hpp"
+
+// shared by the ray-tracer and the rasterizer
+
+struct Triangle
+{
+    glm::vec3 points[3];
+    glm::vec2 texCoords[3];
+    glm::vec3 normals[3];
+};
+
+class Texture
+{
+public:
+    Texture(const std::string& filename)
+    {
+        data_ = stbi_load(filename.c_str(), &size_.x, &size_.y, nullptr, 3);
+
+        if(data_)
+        {
+            del_.set([data = data_]{stbi_image_free(data);});
+        }
+        else
+        {
+            std::cout << "stbi_load() failed: " << filename << std::endl;
+        }
+    }
+
+    glm::ivec2 getSize() const {return size_;}
+
+    const Pixel* getData() const {return reinterpret_cast<Pixel*>(data_);}
+
+private:
+    hppv::Deleter del_;
+    glm::ivec2 size_{0, 0};
+    unsigned char* data_;
+};
+
+inline Pixel operator*(Pixel p, glm::vec3 v)
+{
+    return {static_cast<unsigned char>(p.r * v.r),
+            static_cast<unsigned char>(p.g * v.g),
+            static_cast<unsigned char>(p.b * v.b)};
+}
+
+struct Face
+{
+    glm::ivec3 points; // maybe positions would be better
+    glm::ivec3 texCoords;
+    glm::ivec3 normals;
+};
+
+struct Model
+{
+    Model(const char* const filename)
+    {
+        std::ifstream file(filename);
+
+        if(!file.is_open())
+        {
+            std::cout << "Model: could not open file " << filename << std::endl;
+            return;
+        }
+
+        // todo: reserving memory
+
+        std::string line;
+
+        while(std::getline(file, line))
+        {
+            std::stringstream s(line);
+            std::string t;
+            s >> t;
+
+            if(t == "v" || t == "vn")
+            {
+                glm::vec3 v;
+
+                for(auto i = 0; i < 3; ++i)
+                {
+                    s >> v[i];
+                }
+
+                if(t == "v")
+                {
+                    points.push_back(v);
+                }
+                else
+                {
+                    normals.push_back(v);
+                }
+            }
+            else if(t == "vt")
+            {
+                glm::vec2 texCoord;
+
+                for(auto i = 0; i < 2; ++i)
+                {
+                    s >> texCoord[i];
+                }
+
+                texCoords.push_back(texCoord);
+            }
+            else if(t == "f")
+            {
+                Face face;
+                char dummy;
+
+                for(auto i = 0; i < 3; ++i)
+                {
+                    s >> face.points[i];
+                    s >> dummy;
+                    s >> face.texCoords[i];
+                    s >> dummy;
+                    s >> face.normals[i];
+
+                     // in wavefront obj all indices start at 1, not 0
+
+                    --face.points[i];
+                    --face.texCoords[i];
+                    --face.normals[i];
+                }
+
+                faces.push_back(face);
+            }
+        }
+    }
+
+    std::vector<glm::vec3> points;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+    std::vector<Face> faces;
+};
@@ -1,6 +1,9 @@
 #include <vector>
 #include <thread>
 #include <functional> // std::ref
+#include <memory> // std::unique_ptr
+
+#include <glm/common.hpp> // glm::max
 
 #include <hppv/Renderer.hpp>
 #include <hppv/Texture.hpp>
@@ -19,6 +22,7 @@
 // -----
 
 #include "renderImage.hpp"
+#include "World.hpp"
 #include "../run.hpp"
 
 // update (21-01-2018): the plan is to render the same scene with a ray-tracer, a software rasterizer
@@ -33,12 +37,13 @@
 class RayTracer: public hppv::Scene
 {
 public:
-    RayTracer()
+    RayTracer():
+        image1_(Image::initialSize),
+        image2_(Image::initialSize)
     {
         properties_.maximize = true;
 
-        std::thread t1(renderImage1, image1_.buffer.data(), image1_.size, std::ref(image1_.renderProgress));
-        t1.detach();
+        restartTracer();
 
         std::thread t2(renderImage2, image2_.buffer.data(), image2_.size, std::ref(image2_.renderProgress));
         t2.detach();
@@ -46,21 +51,16 @@ public:
 
     void render(hppv::Renderer& renderer) override
     {
-        // todo?: partial updates?
-        if(!activeImage_->ready && (activeImage_->renderProgress == activeImage_->size.x * activeImage_->size.y))
+        // the first pass is a low resolution preview, the next ones refine the image
+        for(const auto& tile: tracer_->takeFinishedTiles())
         {
-            activeImage_->ready = true;
-
-            GLint unpackAlignment;
-            glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
-            glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // 3 is not supported
-
-            activeImage_->tex.bind();
-
-            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, activeImage_->size.x, activeImage_->size.y, GL_RGB, GL_UNSIGNED_BYTE,
-                            activeImage_->buffer.data());
+            upload(image1_, tile.pos, tile.size, tile.pixels.data());
+        }
 
-            glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+        if(!image2_.ready && (image2_.renderProgress == image2_.size.x * image2_.size.y))
+        {
+            image2_.ready = true;
+            upload(image2_, {0, 0}, image2_.size, image2_.buffer.data());
         }
 
         if(activeImage_->ready)
@@ -127,6 +127,18 @@ public:
             const char* const ids[] = {"ray-tracer", "rasterizer"};
             ImGui::ListBox("technique", &idx, ids, hppv::size(ids));
             activeImage_ = (idx == 0) ? &image1_ : &image2_;
+
+            if(activeImage_ == &image1_)
+            {
+                ImGui::ProgressBar(tracer_->getProgress());
+                ImGui::InputInt2("size", &tracerSize_.x);
+                ImGui::SliderInt("samples", &tracerNumSamples_, 1, 256);
+
+                if(ImGui::Button("restart"))
+                {
+                    restartTracer();
+                }
+            }
         }
         ImGui::End();
     }
@@ -134,9 +146,10 @@ public:
 private:
     struct Image
     {
-        Image(): buffer(size.x * size.y), tex(GL_RGB8, size) {}
+        explicit Image(const glm::ivec2 size): size(size), buffer(size.x * size.y), tex(GL_RGB8, size) {}
 
-        static inline glm::ivec2 size{800, 600};
+        static inline glm::ivec2 initialSize{800, 600};
+        glm::ivec2 size;
         std::vector<Pixel> buffer;
         hppv::Texture tex;
         std::atomic_int renderProgress = 0;
@@ -146,6 +159,44 @@ private:
 
     Image* activeImage_ = &image2_;
 
+    // image1_
+    const World world_; // loaded once, not on every restart
+    std::unique_ptr<TileTracer> tracer_;
+    glm::ivec2 tracerSize_ = Image::initialSize;
+    int tracerNumSamples_ = 16;
+
+    void restartTracer()
+    {
+        tracer_.reset(); // waits for the tiles in progress
+
+        tracerSize_ = glm::max(tracerSize_, 1);
+
+        if(tracerSize_ != image1_.size)
+        {
+            image1_.size = tracerSize_;
+            image1_.tex = hppv::Texture(GL_RGB8, tracerSize_);
+            image1_.buffer.resize(tracerSize_.x * tracerSize_.y);
+        }
+
+        upload(image1_, {0, 0}, image1_.size, image1_.buffer.data()); // black
+        image1_.ready = true;
+
+        tracer_ = std::make_unique<TileTracer>(world_, tracerSize_, tracerNumSamples_);
+    }
+
+    // pixels - row by row, the top row first
+    static void upload(Image& image, const glm::ivec2 pos, const glm::ivec2 size, const Pixel* const pixels)
+    {
+        GLint unpackAlignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // 3 is not supported
+
+        image.tex.bind();
+        glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, size.x, size.y, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+    }
+
     struct D3
     {
         D3(): fb(GL_RGBA8, 1)
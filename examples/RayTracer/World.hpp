@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "Model.hpp"
+#include "Bvh.hpp"
+
+struct Sphere
+{
+    glm::vec3 center;
+    float radius;
+    glm::vec3 color;
+};
+
+// the ray-tracer scene without the planes (they are infinite, they are not in the bvh),
+// loads the african head mesh, shared by the TileTracers
+
+struct World
+{
+    World();
+
+    std::vector<Sphere> spheres;
+    std::vector<Triangle> triangles;
+    Texture texDiffuse; // of the triangles
+
+    // index < spheres.size() - a sphere, otherwise triangles[index - spheres.size()]
+    Bvh bvh;
+};
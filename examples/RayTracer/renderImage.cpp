@@ -1,4 +1,6 @@
 #include <limits>
+#include <thread>
+#include <algorithm> // std::max
 
 #include <glm/vec3.hpp>
 #include <glm/common.hpp>
@@ -7,6 +9,7 @@
 #include <glm/trigonometric.hpp>
 
 #include "renderImage.hpp"
+#include "World.hpp"
 
 // todo: better vector naming
 
@@ -24,13 +27,6 @@ struct Ray
     glm::vec3 dir;
 };
 
-struct Sphere
-{
-    glm::vec3 center;
-    float radius;
-    glm::vec3 color;
-};
-
 struct Plane
 {
     glm::vec3 center;
@@ -83,120 +79,352 @@ bool intersect(const Ray ray, const Plane& plane, float* const distance)
     return true;
 }
 
-void renderImage1(Pixel* buffer, const glm::ivec2 size, std::atomic_int& progress)
+// u, v - the barycentric coordinates of points[1] and points[2] (Moller-Trumbore)
+bool intersect(const Ray ray, const Triangle& triangle, float* const distance, glm::vec2* const uv)
 {
-    Camera camera;
-    camera.eye = {-1.f, 1.5f, 2.f};
+    const auto edge1 = triangle.points[1] - triangle.points[0];
+    const auto edge2 = triangle.points[2] - triangle.points[0];
+    const auto p = glm::cross(ray.dir, edge2);
+    const auto determinant = glm::dot(edge1, p);
+
+    if(glm::abs(determinant) < 0.000001f)
+        return false;
+
+    const auto inverse = 1.f / determinant;
+    const auto s = ray.origin - triangle.points[0];
+    const auto u = glm::dot(s, p) * inverse;
+
+    if(u < 0.f || u > 1.f)
+        return false;
+
+    const auto q = glm::cross(s, edge1);
+    const auto v = glm::dot(ray.dir, q) * inverse;
+
+    if(v < 0.f || u + v > 1.f)
+        return false;
 
-    // camera coordinate system
-    const auto z = glm::normalize(camera.eye - camera.center);
-    const auto x = glm::normalize(glm::cross(camera.up, z));
-    const auto y = glm::cross(z, x);
+    const auto t = glm::dot(edge2, q) * inverse;
 
-    const Sphere spheres[] =
+    if(t < 0.f)
+        return false;
+
+    *distance = t;
+    *uv = {u, v};
+    return true;
+}
+
+// normals must be normalized
+const Plane planes[] =
+{
+    {{0.f, -10.f, 0.f}, {0.f, 1.f, 0.f}, {1.f, 0.f, 0.f}},
+    {{-50.f, 0.f, 0.f}, {1.f, 0.f, 0.f}, {0.f, 0.f, 1.f}}
+};
+
+World::World():
+    spheres
     {
         {{0.f, 0.f, -2.f}, 1.f, {1.f, 0.5f, 0.f}},
         {{-0.8f, 0.f, -2.f}, 1.f, {0.f, 0.f, 1.f}},
         {{0.8f, 0.f, -2.f}, 1.f, {0.f, 1.f, 0.f}},
         {{-1.f, 1.5f, -1.5f}, 0.5f, {1.f, 1.f, 1.f}}
-    };
+    },
+    texDiffuse("res/african_head_diffuse.tga")
+{
+    const Model model("res/african_head.obj");
+
+    const auto meshScale = 0.8f;
+    const glm::vec3 meshPos(1.8f, 0.3f, -0.8f);
 
-    Plane planes [] =
+    triangles.reserve(model.faces.size());
+
+    for(const auto& face: model.faces)
+    {
+        Triangle t;
+
+        for(auto i = 0; i < 3; ++i)
+        {
+            t.points[i] = model.points[face.points[i]] * meshScale + meshPos;
+            t.texCoords[i] = model.texCoords[face.texCoords[i]];
+            t.normals[i] = model.normals[face.normals[i]];
+        }
+
+        triangles.push_back(t);
+    }
+
+    std::vector<Aabb> bounds;
+    bounds.reserve(spheres.size() + triangles.size());
+
+    for(const auto& sphere: spheres)
+    {
+        bounds.push_back({sphere.center - sphere.radius, sphere.center + sphere.radius});
+    }
+
+    for(const auto& triangle: triangles)
     {
-        {{0.f, -10.f, 0.f}, {0.f, 1.f, 0.f}, {1.f, 0.f, 0.f}},
-        {{-50.f, 0.f, 0.f}, {1.f, 0.f, 0.f}, {0.f, 0.f, 1.f}}
-    };
+        Aabb aabb;
+
+        for(const auto point: triangle.points)
+        {
+            aabb.extend(point);
+        }
+
+        bounds.push_back(aabb);
+    }
+
+    bvh = Bvh(bounds);
+}
+
+glm::vec3 trace(const World& world, const Ray ray)
+{
+    auto distance = std::numeric_limits<float>::infinity();
+    const int numSpheres = world.spheres.size();
 
-    for(auto& plane: planes)
+    struct
     {
-        plane.normal = glm::normalize(plane.normal);
+        int primitive = -1; // see World::bvh
+        const Plane* plane = nullptr;
+        glm::vec2 uv; // of a triangle
     }
+    hit;
 
-    const auto aspectRatio = static_cast<float>(size.x) / size.y;
-    const auto scale = glm::tan(glm::radians(camera.fovy / 2.f));
+    world.bvh.intersect(ray.origin, ray.dir, distance, [&world, ray, numSpheres, &hit](const int index, float& closest)
+    {
+        float t;
 
-    Ray ray;
-    ray.origin = camera.eye;
+        if(index < numSpheres)
+        {
+            if(!intersect(ray, world.spheres[index], &t) || t >= closest)
+                return false;
+        }
+        else
+        {
+            glm::vec2 uv;
+
+            if(!intersect(ray, world.triangles[index - numSpheres], &t, &uv) || t >= closest)
+                return false;
 
-    for(auto j = 0; j < size.y; ++j)
+            hit.uv = uv;
+        }
+
+        closest = t;
+        hit.primitive = index;
+        return true;
+    });
+
+    for(const auto& plane: planes)
     {
-        for(auto i = 0; i < size.x; ++i)
+        float t;
+
+        if(intersect(ray, plane, &t) && (t < distance))
         {
-            glm::vec3 rayScreenPos;
-            rayScreenPos.x = (2.f * (i + 0.5f) / size.x - 1.f) * scale * aspectRatio;
-            rayScreenPos.y = (1.f - 2.f * (j + 0.5f) / size.y) * scale;
-            rayScreenPos.z = -1.f;
+            distance = t;
+            hit.plane = &plane;
+        }
+    }
 
-            ray.dir = glm::normalize(x * rayScreenPos.x + y * rayScreenPos.y + z * rayScreenPos.z);
+    if(hit.plane)
+    {
+        const auto dot = glm::dot(-ray.dir, hit.plane->normal);
+        return hit.plane->color * glm::abs(dot);
+    }
 
-            auto distance = std::numeric_limits<float>::infinity();
+    if(hit.primitive == -1)
+        return {0.f, 0.f, 0.f};
 
-            // it doesn't scale very well, I know
-            // at the end we will triangulate everything
+    if(hit.primitive < numSpheres)
+    {
+        const auto hitPoint = ray.origin + ray.dir * distance;
+        const auto& sphere = world.spheres[hit.primitive];
+        const auto normal = glm::normalize(hitPoint - sphere.center);
+        const auto dot = glm::dot(-ray.dir, normal);
+        return sphere.color * dot;
+    }
 
-            enum class Object
-            {
-                Sphere,
-                Plane
-            };
+    const auto& triangle = world.triangles[hit.primitive - numSpheres];
+    const glm::vec3 weights(1.f - hit.uv.x - hit.uv.y, hit.uv.x, hit.uv.y);
 
-            struct
-            {
-                const void* object = nullptr;
-                Object type;
-            }
-            hit;
+    glm::vec3 normal(0.f);
+    glm::vec2 texCoord(0.f);
 
-            for(const auto& sphere: spheres)
-            {
-                float t;
+    for(auto i = 0; i < 3; ++i)
+    {
+        normal += triangle.normals[i] * weights[i];
+        texCoord += triangle.texCoords[i] * weights[i];
+    }
 
-                if(intersect(ray, sphere, &t) && (t < distance))
-                {
-                    distance = t;
-                    hit.object = &sphere;
-                    hit.type = Object::Sphere;
-                }
-            }
+    const auto dot = glm::abs(glm::dot(-ray.dir, glm::normalize(normal)));
+    const auto texSize = world.texDiffuse.getSize();
+
+    if(texSize.x == 0)
+        return glm::vec3(dot);
+
+    // the first row of the image is the top one
+    const glm::ivec2 texel = glm::clamp(glm::vec2(texCoord.x, 1.f - texCoord.y), 0.f, 1.f) * glm::vec2(texSize - 1);
+    const auto pixel = world.texDiffuse.getData()[texel.y * texSize.x + texel.x];
+
+    return glm::vec3(pixel.r, pixel.g, pixel.b) / 255.f * dot;
+}
+
+// the camera coordinate system
+struct View
+{
+    explicit View(const glm::ivec2 size):
+        size(size)
+    {
+        Camera camera;
+        camera.eye = {-1.f, 1.5f, 2.f};
+
+        eye = camera.eye;
+        z = glm::normalize(camera.eye - camera.center);
+        x = glm::normalize(glm::cross(camera.up, z));
+        y = glm::cross(z, x);
+
+        const auto aspectRatio = static_cast<float>(size.x) / size.y;
+        scale.y = glm::tan(glm::radians(camera.fovy / 2.f));
+        scale.x = scale.y * aspectRatio;
+    }
+
+    // pos - in pixels, (0, 0) - the top left corner of the image
+    Ray primaryRay(const glm::vec2 pos) const
+    {
+        glm::vec3 rayScreenPos;
+        rayScreenPos.x = (2.f * pos.x / size.x - 1.f) * scale.x;
+        rayScreenPos.y = (1.f - 2.f * pos.y / size.y) * scale.y;
+        rayScreenPos.z = -1.f;
+
+        Ray ray;
+        ray.origin = eye;
+        ray.dir = glm::normalize(x * rayScreenPos.x + y * rayScreenPos.y + z * rayScreenPos.z);
+        return ray;
+    }
+
+    glm::vec2 size;
+    glm::vec2 scale;
+    glm::vec3 eye, x, y, z;
+};
+
+// in [0, 1)
+float hash(unsigned x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return (x >> 8) * (1.f / (1 << 24));
+}
+
+TileTracer::TileTracer(const World& world, const glm::ivec2 size, const int numSamples):
+    world_(world),
+    size_(size),
+    numSamples_(numSamples),
+    numTiles_((size + static_cast<int>(TileSize) - 1) / static_cast<int>(TileSize)),
+    numPasses_(numTiles_.x * numTiles_.y * (numSamples + 1)),
+    accumulation_(size.x * size.y, glm::vec3(0.f)),
+    tiles_(std::make_unique<TileState[]>(numTiles_.x * numTiles_.y)),
+    jobs_(std::max(1u, std::thread::hardware_concurrency()) + 1)
+{
+    for(auto i = 1; i < jobs_.getNumThreads(); ++i)
+    {
+        jobs_.schedule([this]{work();});
+    }
+}
+
+TileTracer::~TileTracer()
+{
+    quit_ = true;
+}
 
-            for(const auto& plane: planes)
+std::vector<TileTracer::Tile> TileTracer::takeFinishedTiles()
+{
+    std::vector<Tile> tiles;
+
+    {
+        std::lock_guard<std::mutex> lock(mutexFinished_);
+        tiles.swap(finished_);
+    }
+
+    return tiles;
+}
+
+float TileTracer::getProgress() const
+{
+    return static_cast<float>(numPassesDone_) / numPasses_;
+}
+
+// the passes of all the tiles are taken in order, so the whole image is refined evenly
+void TileTracer::work()
+{
+    const auto numTiles = numTiles_.x * numTiles_.y;
+
+    for(int pass; !quit_ && (pass = nextPass_++) < numPasses_;)
+    {
+        renderTile(pass % numTiles);
+        ++numPassesDone_;
+    }
+}
+
+void TileTracer::renderTile(const int index)
+{
+    auto& state = tiles_[index];
+
+    // the previous pass of the tile might be still in progress
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    Tile tile;
+    tile.pos = glm::ivec2(index % numTiles_.x, index / numTiles_.x) * static_cast<int>(TileSize);
+    tile.size = glm::min(glm::ivec2(TileSize), size_ - tile.pos);
+    tile.pass = state.numPasses++;
+    tile.pixels.resize(tile.size.x * tile.size.y);
+
+    const View view(size_);
+
+    if(tile.pass == 0)
+    {
+        for(auto j = 0; j < tile.size.y; j += PreviewBlockSize)
+        {
+            for(auto i = 0; i < tile.size.x; i += PreviewBlockSize)
             {
-                float t;
+                const auto blockSize = glm::min(glm::ivec2(PreviewBlockSize), tile.size - glm::ivec2(i, j));
+                const auto pos = glm::vec2(tile.pos + glm::ivec2(i, j)) + glm::vec2(blockSize) / 2.f;
+                const auto pixel = toPixel(trace(world_, view.primaryRay(pos)));
 
-                if(intersect(ray, plane, &t) && (t < distance))
+                for(auto y = j; y < j + blockSize.y; ++y)
                 {
-                    distance = t;
-                    hit.object = &plane;
-                    hit.type = Object::Plane;
+                    for(auto x = i; x < i + blockSize.x; ++x)
+                    {
+                        tile.pixels[y * tile.size.x + x] = pixel;
+                    }
                 }
             }
-
-            if(hit.object)
+        }
+    }
+    else
+    {
+        for(auto j = 0; j < tile.size.y; ++j)
+        {
+            for(auto i = 0; i < tile.size.x; ++i)
             {
-                switch(hit.type)
-                {
-                case Object::Sphere:
-                {
-                    const auto hitPoint = ray.origin + ray.dir * distance;
-                    const auto& sphere = *reinterpret_cast<const Sphere*>(hit.object);
-                    const auto normal = glm::normalize(hitPoint - sphere.center);
-                    const auto dot = glm::dot(-ray.dir, normal);
-                    *buffer = toPixel(sphere.color * dot);
-                    break;
-                }
-                case Object::Plane:
+                const auto pixelPos = tile.pos + glm::ivec2(i, j);
+                const auto idx = pixelPos.y * size_.x + pixelPos.x;
+
+                glm::vec2 offset(0.5f);
+
+                if(tile.pass > 1)
                 {
-                    const auto& plane = *reinterpret_cast<const Plane*>(hit.object);
-                    const auto dot = glm::dot(-ray.dir, plane.normal);
-                    *buffer = toPixel(plane.color * glm::abs(dot));
+                    const auto seed = (static_cast<unsigned>(idx) * numSamples_ + tile.pass) * 2;
+                    offset = {hash(seed), hash(seed + 1)};
                 }
-                }
-            }
 
-            ++buffer;
-            ++progress;
+                auto& sum = accumulation_[idx];
+                sum += trace(world_, view.primaryRay(glm::vec2(pixelPos) + offset));
+                tile.pixels[j * tile.size.x + i] = toPixel(sum / static_cast<float>(tile.pass));
+            }
         }
     }
+
+    std::lock_guard<std::mutex> lockFinished(mutexFinished_);
+    finished_.push_back(std::move(tile));
 }
 
 // -----
@@ -204,15 +432,6 @@ void renderImage1(Pixel* buffer, const glm::ivec2 size, std::atomic_int& progres
 
 #include <cassert>
 #include <utility> // std::swap
-#include <vector>
-#include <fstream>
-#include <iostream>
-#include <string>
-#include <sstream>
-
-#include <hppv/Deleter.hpp>
-
-#include "../src/stb_image.h"
 
 void drawLine(glm::ivec2 start, glm::ivec2 end, const glm::vec3 color,
               Pixel* const buffer, const glm::ivec2 imageSize)
@@ -256,13 +475,6 @@ void drawLine(glm::ivec2 start, glm::ivec2 end, const glm::vec3 color,
     }
 }
 
-struct Triangle
-{
-    glm::vec3 points[3];
-    glm::vec2 texCoords[3];
-    glm::vec3 normals[3];
-};
-
 glm::vec3 barycentric(const glm::vec3* const points, glm::ivec2 P)
 {
     const auto u = glm::cross(glm::vec3(points[2][0] - points[0][0], points[1][0] - points[0][0], points[0][0] - P[0]),
@@ -275,40 +487,6 @@ glm::vec3 barycentric(const glm::vec3* const points, glm::ivec2 P)
     return {1.f - (u.x + u.y) / u.z, u.y / u.z, u.x/ u.z};
 }
 
-class Texture
-{
-public:
-    Texture(const std::string& filename)
-    {
-        data_ = stbi_load(filename.c_str(), &size_.x, &size_.y, nullptr, 3);
-
-        if(data_)
-        {
-            del_.set([data = data_]{stbi_image_free(data);});
-        }
-        else
-        {
-            std::cout << "stbi_load() failed: " << filename << std::endl;
-        }
-    }
-
-    glm::ivec2 getSize() const {return size_;}
-
-    const Pixel* getData() const {return reinterpret_cast<Pixel*>(data_);}
-
-private:
-    hppv::Deleter del_;
-    glm::ivec2 size_{0, 0};
-    unsigned char* data_;
-};
-
-Pixel operator*(Pixel p, glm::vec3 v)
-{
-    return {static_cast<unsigned char>(p.r * v.r),
-            static_cast<unsigned char>(p.g * v.g),
-            static_cast<unsigned char>(p.b * v.b)};
-}
-
 void drawTriangle(Triangle t, const glm::vec3 color, Pixel* const buffer, float* const depthBuffer,
                   const glm::ivec2 imageSize, const Texture& texDiffuse)
 {
@@ -382,95 +560,6 @@ void drawTriangle(Triangle t, const glm::vec3 color, Pixel* const buffer, float*
     }
 }
 
-struct Face
-{
-    glm::ivec3 points; // maybe positions would be better
-    glm::ivec3 texCoords;
-    glm::ivec3 normals;
-};
-
-struct Model
-{
-    Model(const char* const filename)
-    {
-        std::ifstream file(filename);
-
-        if(!file.is_open())
-        {
-            std::cout << "Model: could not open file " << filename << std::endl;
-            return;
-        }
-
-        // todo: reserving memory
-
-        std::string line;
-
-        while(std::getline(file, line))
-        {
-            std::stringstream s(line);
-            std::string t;
-            s >> t;
-
-            if(t == "v" || t == "vn")
-            {
-                glm::vec3 v;
-
-                for(auto i = 0; i < 3; ++i)
-                {
-                    s >> v[i];
-                }
-
-                if(t == "v")
-                {
-                    points.push_back(v);
-                }
-                else
-                {
-                    normals.push_back(v);
-                }
-            }
-            else if(t == "vt")
-            {
-                glm::vec2 texCoord;
-
-                for(auto i = 0; i < 2; ++i)
-                {
-                    s >> texCoord[i];
-                }
-
-                texCoords.push_back(texCoord);
-            }
-            else if(t == "f")
-            {
-                Face face;
-                char dummy;
-
-                for(auto i = 0; i < 3; ++i)
-                {
-                    s >> face.points[i];
-                    s >> dummy;
-                    s >> face.texCoords[i];
-                    s >> dummy;
-                    s >> face.normals[i];
-
-                     // in wavefront obj all indices start at 1, not 0
-
-                    --face.points[i];
-                    --face.texCoords[i];
-                    --face.normals[i];
-                }
-
-                faces.push_back(face);
-            }
-        }
-    }
-
-    std::vector<glm::vec3> points;
-    std::vector<glm::vec2> texCoords;
-    std::vector<glm::vec3> normals;
-    std::vector<Face> faces;
-};
-
 void renderImage2(Pixel* const buffer, const glm::ivec2 size, std::atomic_int& progress)
 {
     const auto bufferSize = size.x * size.y;
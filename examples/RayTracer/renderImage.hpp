@@ -1,8 +1,16 @@
 #pragma once
 
 #include <atomic>
+#include <vector>
+#include <mutex>
+#include <memory> // std::unique_ptr
 
 #include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <hppv/Jobs.hpp>
+
+struct World;
 
 struct Pixel
 {
@@ -10,10 +18,74 @@ struct Pixel
     unsigned char r = 0, g = 0, b = 0;
 };
 
-// progress - incremented for each pixel rendered
+// ray-tracer, the spheres and the triangles are in a bvh (see Bvh.hpp)
+//
+// the image is split into tiles rendered on all the cores, every tile is rendered in passes:
+// 0 - one sample per PreviewBlockSize^2 pixels, 1 - one sample per pixel (center),
+// next - one jittered sample per pixel (accumulated), up to numSamples
+
+class TileTracer
+{
+public:
+    enum
+    {
+        TileSize = 32,
+        PreviewBlockSize = 8
+    };
+
+    struct Tile
+    {
+        glm::ivec2 pos;
+        glm::ivec2 size;
+        int pass;
+        std::vector<Pixel> pixels; // row by row, the top row first
+    };
+
+    // world must outlive the TileTracer
+    TileTracer(const World& world, glm::ivec2 size, int numSamples);
+
+    // waits for the tiles in progress
+    ~TileTracer();
+
+    TileTracer(const TileTracer&) = delete;
+    TileTracer& operator=(const TileTracer&) = delete;
 
-// ray-tracer
-void renderImage1(Pixel* buffer, glm::ivec2 size, std::atomic_int& progress);
+    // the tiles finished since the last call
+    std::vector<Tile> takeFinishedTiles();
+
+    // in [0, 1]
+    float getProgress() const;
+
+    glm::ivec2 getSize() const {return size_;}
+    int getNumSamples() const {return numSamples_;}
+
+private:
+    struct TileState
+    {
+        std::mutex mutex; // a tile is rendered by one thread at a time
+        int numPasses = 0;
+    };
+
+    const World& world_;
+    const glm::ivec2 size_;
+    const int numSamples_;
+    const glm::ivec2 numTiles_;
+    const int numPasses_; // of all the tiles
+    std::vector<glm::vec3> accumulation_; // the sum of the samples
+    std::unique_ptr<TileState[]> tiles_;
+    std::atomic_int nextPass_ = 0;
+    std::atomic_int numPassesDone_ = 0;
+    std::atomic_bool quit_ = false;
+    std::mutex mutexFinished_;
+    std::vector<Tile> finished_;
+
+    // nobody waits for the jobs, so one more thread than the cores (see Jobs::Jobs()),
+    // destroyed first (waits for the jobs)
+    hppv::Jobs jobs_;
+
+    void work();
+    void renderTile(int index);
+};
 
-// rasterizer
+// rasterizer, progress - incremented for each pixel rendered
 void renderImage2(Pixel* buffer, glm::ivec2 size, std::atomic_int& progress);
@@ -18,7 +18,7 @@ public:
         sdfFont_("res/sdf.fnt"),
         proggy_("res/proggy.fnt")
     {
-        gnu_.tex = hppv::Texture("res/gnu.png");
+        gnu_.tex = hppv::Texture("res/gnu.png", true);
     }
 
 private:
@@ -83,8 +83,10 @@ private:
             sprite.size = gnu_.size;
 
             renderer.shader(hppv::Render::Tex);
+            renderer.sampler(hppv::Sample::Trilinear);
             renderer.texture(gnu_.tex);
             renderer.cache(sprite);
+            renderer.sampler(hppv::Sample::Linear);
         }
         // sdf font
         {
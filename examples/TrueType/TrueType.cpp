@@ -8,7 +8,8 @@ class TrueType: public hppv::Scene
 public:
     TrueType():
         font1_("res/SourceCodePro-Regular.otf", 26, u8"ĄąĆćĘęŁłŃńÓóŚśŹźŻż"),
-        font2_(hppv::Font::Default(), 13)
+        font2_(hppv::Font::Default(), 13),
+        fontSdf_(hppv::Font::Sdf(), "res/SourceCodePro-Regular.otf", 32)
     {
         properties_.maximize = true;
     }
@@ -84,10 +85,25 @@ public:
                     "}";
 
         renderer.cache(text);
+
+        renderer.shader(hppv::Render::Sdf);
+        renderer.texture(fontSdf_.getTexture());
+
+        text.pos = {700.f, 100.f};
+        text.font = &fontSdf_;
+        text.color = {0.f, 0.5f, 1.f, 1.f};
+        text.text = "generated sdf";
+
+        for(auto scale: {0.5f, 1.f, 2.f, 4.f})
+        {
+            text.scale = scale;
+            renderer.cache(text);
+            text.pos.y += text.getSize().y;
+        }
     }
 
 private:
-    hppv::Font font1_, font2_;
+    hppv::Font font1_, font2_, fontSdf_;
 };
 
 RUN(TrueType)
@@ -1,11 +1,47 @@
+#include <cstdlib> // std::getenv, std::atoi
+
 #include <hppv/App.hpp>
 
+// HPPV_CAPTURE=video.y4m or HPPV_CAPTURE=frames/prefix (png sequence)
+// HPPV_CAPTURE_FRAMES=600 - headless, quits after 600 frames
+// HPPV_SHADER_CACHE=shader_cache - the shader binary cache directory (see Shader::setBinaryCacheDir())
+
+inline void setCapture(hppv::App::InitParams& p)
+{
+    const char* const filename = std::getenv("HPPV_CAPTURE");
+
+    if(!filename)
+        return;
+
+    p.capture.filename = filename;
+    const auto& f = p.capture.filename;
+    const auto y4m = f.size() > 4 && f.compare(f.size() - 4, 4, ".y4m") == 0;
+    p.capture.format = y4m ? hppv::Capture::Y4m : hppv::Capture::Png;
+
+    if(const char* const numFrames = std::getenv("HPPV_CAPTURE_FRAMES"))
+    {
+        p.capture.numFrames = std::atoi(numFrames);
+        p.capture.headless = true;
+        p.window.state = hppv::Window::Restored;
+    }
+}
+
+inline void setShaderCache(hppv::App::InitParams& p)
+{
+    if(const char* const dir = std::getenv("HPPV_SHADER_CACHE"))
+    {
+        p.shaderBinaryCacheDir = dir;
+    }
+}
+
 #define RUN(SceneType) \
     int main() { \
     hppv::App app; \
     hppv::App::InitParams p; \
     p.window.title = #SceneType; \
     p.window.state = hppv::Window::Fullscreen; \
+    setCapture(p); \
+    setShaderCache(p); \
     if(!app.initialize(p)) return 1; \
     app.pushScene(std::make_unique<SceneType>()); \
     app.run(); \
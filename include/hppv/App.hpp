@@ -8,6 +8,8 @@
 #include "Event.hpp"
 #include "Frame.hpp"
 #include "Deleter.hpp"
+#include "Capture.hpp"
+#include "Jobs.hpp"
 
 struct GLFWwindow;
 
@@ -72,6 +74,13 @@ public:
         bool printDebugInfo = false;
         bool handleQuitEvent = true;
 
+        // see Shader::setBinaryCacheDir(), empty - disabled
+        std::string shaderBinaryCacheDir;
+
+        // see Shader::setDeferredCompilation(),
+        // run() shows a loading screen until the deferred shaders are compiled
+        bool deferShaderCompilation = false;
+
         struct
         {
             int major = 3;
@@ -89,6 +98,24 @@ public:
             Window::State previousState = Window::Restored;
         }
         window;
+
+        // records the window content (including imgui), see Capture
+        struct
+        {
+            std::string filename; // empty - no capture
+            Capture::Format format = Capture::Y4m;
+
+            // Frame::time is fixed to 1 / fps, so the result doesn't depend on the frame rate
+            int fps = 60;
+
+            int numFrames = 0; // quits after that many frames, 0 - no limit
+
+            // invisible window and no vsync, the capture runs as fast as possible,
+            // the frames are rendered into an offscreen Framebuffer (the back buffer
+            // of an invisible window is undefined), see Framebuffer::setDefault()
+            bool headless = false;
+        }
+        capture;
     };
 
     bool initialize(const InitParams& initParams);
@@ -105,6 +132,10 @@ public:
     // see Prototype.cpp for proper usage
     static glm::vec2 getCursorPos();
 
+    // created on the first call, run() waits for all the jobs
+    // after Scene::update() and at the end of a frame
+    static Jobs& getJobs();
+
 private:
     enum
     {
@@ -116,15 +147,23 @@ private:
     Deleter deleterGlfw_;
     Deleter deleterImgui_;
     std::vector<std::unique_ptr<Scene>> scenes_;
+    std::unique_ptr<Capture> capture_;
+    std::unique_ptr<Framebuffer> headlessFramebuffer_;
+    Deleter deleterDefaultFramebuffer_;
+    int captureNumFrames_;
+    float captureFrameTime_;
     static GLFWwindow* window_;
     static Frame frame_;
     static bool handleQuitEvent_;
     static std::vector<Request> requests_;
     static std::vector<Event> events_;
+    static std::unique_ptr<Jobs> jobs_;
 
     static void refreshFrame();
+    static void waitForShaders();
     static void setFullscreen();
     static void handleRequests();
+    static void waitForJobs();
 
     static void errorCallback(int, const char* description);
     static void windowCloseCallback(GLFWwindow*);
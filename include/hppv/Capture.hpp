@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+
+#include <glm/vec2.hpp>
+
+#include "Framebuffer.hpp"
+
+namespace hppv
+{
+
+// records the default framebuffer or a Framebuffer, see App::InitParams::capture
+//
+// the frames are read back through Readback objects (a few frames of latency)
+// and encoded by the worker threads, the render thread blocks only
+// when the workers fall behind
+
+class Capture
+{
+public:
+    enum Format
+    {
+        Y4m, // filename - the video file (4:2:0, full range BT.601)
+        Png // filename - prefix, frames are saved as <prefix>000000.png, ...
+    };
+
+    // numThreads == 0 - std::thread::hardware_concurrency()
+    Capture(Format format, const std::string& filename, int fps, int numThreads = 0);
+
+    // call on the GL thread, waits for all the frames to be written
+    ~Capture();
+
+    Capture(const Capture&) = delete;
+    Capture& operator=(const Capture&) = delete;
+
+    // call after the rendering, before swapping the buffers
+    void captureFrame(glm::ivec2 size);
+
+    // reads the first attachment
+    void captureFrame(Framebuffer& framebuffer);
+
+    int getNumFrames() const {return numFrames_;}
+
+private:
+    enum {NumReadbacks = 3};
+
+    struct Job
+    {
+        int frame;
+        glm::ivec2 size;
+        std::vector<unsigned char> pixels; // rgba, bottom-up
+    };
+
+    struct EncodedFrame
+    {
+        glm::ivec2 size;
+        std::vector<unsigned char> yuv;
+    };
+
+    const Format format_;
+    const std::string filename_;
+    const int fps_;
+    int maxJobs_;
+    int numFrames_ = 0;
+
+    // GL thread only
+    Readback readbacks_[NumReadbacks];
+    int readbackFrames_[NumReadbacks];
+    int readbackIndex_ = 0;
+
+    // shared with the worker threads
+    std::mutex mutex_;
+    std::condition_variable condition_; // jobs_ not empty or quit_
+    std::condition_variable conditionSpace_; // jobs_ below the limit
+    std::deque<Job> jobs_;
+    std::vector<std::vector<unsigned char>> freeBuffers_;
+    bool quit_ = false;
+
+    // Y4m, frames are written in order
+    std::mutex mutexFile_;
+    std::ofstream file_;
+    glm::ivec2 fileSize_ = {0, 0}; // of the first frame
+    int nextFrameToWrite_ = 0;
+    std::map<int, EncodedFrame> encodedFrames_;
+
+    std::vector<std::thread> threads_;
+
+    // collects the oldest transfer if it is still pending
+    Readback& getNextReadback();
+
+    void collect(int readbackIndex);
+    void work();
+    void writeY4m(int frame, glm::ivec2 size, std::vector<unsigned char>&& yuv);
+};
+
+} // namespace hppv
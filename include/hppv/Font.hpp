@@ -1,8 +1,10 @@
 #pragma once
 
 #include <map>
+#include <vector>
 #include <string>
 #include <string_view>
+#include <cstdint> // std::uint64_t
 
 #include <glm/vec2.hpp>
 #include <glm/vec4.hpp>
@@ -28,6 +30,7 @@ class Font
 {
 public:
     struct Default {};
+    struct Sdf {};
 
     Font() = default;
 
@@ -46,25 +49,53 @@ public:
     // create a font from the embedded ProggyClean.ttf
     Font(Default, int sizePx, std::string_view additionalChars = "");
 
+    // TrueType / OpenType only
+    // generates a signed distance field atlas (use with Render::Sdf*),
+    // one atlas serves all the Text::scale values, sizePx is the glyph size in the atlas
+    Font(Sdf, const std::string& filename, int sizePx = 52, std::string_view additionalChars = "");
+
     Texture& getTexture() {return texture_;}
 
     Glyph getGlyph(int code) const;
 
     int getLineHeight() const {return lineHeight_;}
 
+    // check it once before the layout loop, fonts without kerning pairs pay nothing
+    bool hasKerning() const {return kerning_.size();}
+
+    // returns 0 if the pair is not kerned
+    int getKerning(int first, int second) const;
+
 private:
     // todo: proper packing
     enum {TexSizeX = 512, Offset = 1};
 
+    // sdf glyphs are rasterized SdfUpscale times larger and then downsampled,
+    // SdfSpread - distance in pixels (of the atlas) mapped to [0.5, 0.0] outside and [0.5, 1.0] inside a glyph
+    enum {SdfUpscale = 4, SdfSpread = 4};
+
     Texture texture_;
     // todo?: replace int with unsigned int?
     std::map<int, Glyph> glyphs_;
     int lineHeight_;
 
+    // TrueType - only the 'kern' table is supported (no GPOS)
+
+    struct KerningPair
+    {
+        std::uint64_t key; // 0 - empty slot
+        int amount;
+    };
+
+    // open addressing with linear probing, size is a power of 2 or 0
+    std::vector<KerningPair> kerning_;
+
+    void setKerning(const std::vector<KerningPair>& pairs);
+
     void loadFnt(const std::string& filename);
 
     void loadTrueType(const unsigned char* ttfData, int sizePx, std::string_view additionalChars,
-                      std::string_view id);
+                      std::string_view id, bool sdf);
 };
 
 } // namespace hppv
@@ -2,36 +2,131 @@
 
 #include "Texture.hpp"
 #include "GLobjects.hpp"
+#include "Deleter.hpp"
+
+using GLsync = struct __GLsync*;
 
 namespace hppv
 {
 
+// pixels of a Framebuffer::readAsync() transfer (GL_RGBA, GL_UNSIGNED_BYTE,
+// the first row is the bottom one)
+//
+// the transfer is ready typically a frame or two later, reuse the objects
+// (e.g. a ring of three) to avoid the pixel buffer reallocations
+
+class Readback
+{
+public:
+    Readback() = default;
+    Readback(Readback&& rhs) {*this = std::move(rhs);}
+
+    // rhs is left with nothing requested (and with the pixel buffer of this)
+    Readback& operator=(Readback&& rhs);
+
+    // false if nothing was requested
+    bool isPending() const {return fence_;}
+
+    // does not block
+    bool isReady();
+
+    // blocks if the transfer is not ready,
+    // the pointer is valid until unmap(), the next readAsync() or the destruction
+    const unsigned char* getPixels();
+
+    // call on the GL thread
+    void unmap();
+
+    glm::ivec2 getSize() const {return size_;}
+
+private:
+    friend class Framebuffer;
+
+    GLbo pbo_;
+    glm::ivec2 capacity_ = {0, 0};
+    glm::ivec2 size_ = {0, 0};
+    GLsync fence_ = nullptr;
+    const unsigned char* pixels_ = nullptr;
+    Deleter deleterFence_;
+
+    void request(GLuint framebuffer, GLenum buffer, glm::ivec2 size);
+};
+
 class Framebuffer
 {
 public:
     enum {MaxAttachments = 5};
 
-    Framebuffer(GLenum textureFormat, int numAttachments);
+    // samples > 0 - the rendering goes to the multisample renderbuffers,
+    // call resolve() before using the textures
+    // (hardware antialiasing, Renderer::antialiasedSprites() is not needed)
+
+    // depthStencil - GL_DEPTH24_STENCIL8 renderbuffer, see Renderer::stencilWrite()
+    Framebuffer(GLenum textureFormat, int numAttachments, int samples = 0, bool depthStencil = false);
 
     void bind();
 
-    void unbind(); // binds default framebuffer
+    void unbind(); // binds the default framebuffer, see setDefault()
 
+    // the framebuffer unbind() binds instead of the window one (App in the headless capture mode),
+    // nullptr - the window framebuffer
+    static void setDefault(Framebuffer* framebuffer);
+
+    // multisample: the resolved content
     Texture& getTexture(int attachment = 0) {return textures_[attachment];}
 
     glm::ivec2 getSize() const {return textures_[0].getSize();}
 
+    GLenum getTextureFormat() const {return textureFormat_;}
+
+    int getNumAttachments() const {return numAttachments_;}
+
+    int getSamples() const {return samples_;}
+
+    bool hasDepthStencil() const {return depthStencil_;}
+
     // call bind before these
 
+    // does nothing if the size has not changed
     void setSize(glm::ivec2 size);
 
+    // clears the depth and stencil too
     void clear();
 
+    // multisample only, blits the renderbuffers into the textures,
+    // doesn't need bind() (keeps the current binding)
+    void resolve();
+
+    // doesn't need bind(), doesn't block, see Readback
+    // multisample: reads the resolved content
+    void readAsync(Readback& readback, int attachment = 0);
+
+    Readback readAsync(int attachment = 0)
+    {
+        Readback readback;
+        readAsync(readback, attachment);
+        return readback;
+    }
+
+    // reads the back buffer of the default framebuffer
+    static void readDefaultAsync(Readback& readback, glm::ivec2 size);
+
 private:
+    static inline GLuint defaultFramebuffer_ = 0;
+
     GLenum textureFormat_;
     int numAttachments_;
+    int samples_;
+    bool depthStencil_;
     GLframebuffer framebuffer_;
     Texture textures_[MaxAttachments];
+
+    // multisample only, framebuffer_ has the renderbuffers attached
+    GLframebuffer framebufferResolve_;
+    GLrenderbuffer renderbuffers_[MaxAttachments];
+
+    GLrenderbuffer renderbufferDepthStencil_;
+    bool hasStorage_ = false;
 };
 
 } // namespace hppv
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "Framebuffer.hpp"
+
+namespace hppv
+{
+
+// transient render targets, keyed by all the Framebuffer constructor arguments and the size
+//
+// FramebufferPool pool;
+//
+// every frame:
+// pool.nextFrame();
+// auto& fb = pool.acquire(GL_RGBA8, {256, 256});
+// fb.bind();
+// ...
+
+class FramebufferPool
+{
+public:
+    // framebuffers not acquired for this many frames are deleted
+    explicit FramebufferPool(int maxIdleFrames = 60);
+
+    // the returned framebuffer has the storage of the requested size
+    // and stays valid until release() or nextFrame() is called,
+    // keeps the current framebuffer binding
+    Framebuffer& acquire(GLenum textureFormat, glm::ivec2 size, int numAttachments = 1, int samples = 0,
+                         bool depthStencil = false);
+
+    void release(Framebuffer& framebuffer);
+
+    // releases all the acquired framebuffers
+    void nextFrame();
+
+    int getNumFramebuffers() const {return entries_.size();}
+
+private:
+    struct Entry
+    {
+        std::unique_ptr<Framebuffer> framebuffer;
+        int samples; // requested, Framebuffer clamps it to GL_MAX_SAMPLES
+        bool acquired;
+        int idleFrames;
+    };
+
+    int maxIdleFrames_;
+    std::vector<Entry> entries_;
+};
+
+} // namespace hppv
@@ -71,4 +71,10 @@ public:
     GLframebuffer();
 };
 
+class GLrenderbuffer: public GLobject
+{
+public:
+    GLrenderbuffer();
+};
+
 } // namespace hppv
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "GLobjects.hpp"
+#include "Shader.hpp"
+#include "Renderer.hpp"
+
+namespace hppv
+{
+
+// particles simulated on the GPU and rendered by the Renderer as circles
+//
+// GpuParticles particles(100000);
+// particles.spawn = {...}; ...
+//
+// every frame:
+// particles.update(frame_.time);
+// renderer.shader(Render::CircleColor);
+// particles.render(renderer);
+//
+// Compute (GL 4.3): the particle buffers are ping-ponged, the dead particles are
+// respawned in the order given by an atomic counter
+// TransformFeedback (GL 3.3): the particles are spawned into a ring of slots,
+// the oldest particles might be replaced before they die
+
+class GpuParticles
+{
+public:
+    enum class Backend
+    {
+        Auto, // Compute if supported
+        Compute,
+        TransformFeedback
+    };
+
+    explicit GpuParticles(int maxParticles, Backend backend = Backend::Auto);
+
+    void update(float dt);
+
+    // the renderer state (shader, texture, blending, ...) applies,
+    // the buffer is read in renderer.flush()
+    void render(Renderer& renderer);
+
+    Backend getBackend() const {return backend_;}
+    int getMaxParticles() const {return maxParticles_;}
+
+    // ----- spawn
+
+    struct
+    {
+        glm::vec2 pos = {0.f, 0.f};
+        glm::vec2 size = {0.f, 0.f};
+        float hz = 0.f;
+    }
+    spawn;
+
+    // min < 0 - the particles never die (colorEnd is not used)
+    struct {float min = 1.f, max = 1.f;} life;
+    struct {float min = 1.f, max = 1.f;} radius;
+    struct {glm::vec2 min = {0.f, 0.f}, max = {0.f, 0.f};} vel;
+    struct {glm::vec4 min = {1.f, 1.f, 1.f, 1.f}, max = {1.f, 1.f, 1.f, 1.f};} colorStart;
+    struct {glm::vec4 min = {1.f, 1.f, 1.f, 0.f}, max = {1.f, 1.f, 1.f, 0.f};} colorEnd;
+
+    // added to the color (not accumulated), color + colorPerSpeed * length(vel)
+    glm::vec4 colorPerSpeed = {0.f, 0.f, 0.f, 0.f};
+
+    // ----- forces
+
+    glm::vec2 gravity = {0.f, 0.f};
+    float drag = 0.f; // vel *= exp(-drag * dt)
+    float quadraticDrag = 0.f; // speed -= min(speed, quadraticDrag * speed^2 * dt)
+
+    // acc = strength / distance^2, at most maxAcc
+    struct
+    {
+        glm::vec2 pos = {0.f, 0.f};
+        float strength = 0.f;
+        float maxAcc = 100.f;
+    }
+    attractor;
+
+private:
+    enum {LocalSize = 256};
+
+    // the Renderer instance followed by the simulation state
+    struct Particle
+    {
+        Renderer::Instance instance; // matrix == 0 - dead
+        glm::vec2 vel;
+        float life; // 0 - dead, < 0 - never dies
+        glm::vec4 colorVel;
+    };
+
+    const int maxParticles_;
+    Backend backend_;
+    GLbo buffers_[2];
+    GLvao vaos_[2]; // TransformFeedback, reading from buffers_
+    GLbo boCounter_; // Compute
+    Shader shader_;
+    int current_ = 0; // index of the buffer with the current state
+    float spawnAccumulator_ = 0.f;
+    unsigned spawnStart_ = 0; // TransformFeedback, the ring position
+    unsigned seed_ = 0;
+
+    void setUniforms(float dt, int numToSpawn);
+};
+
+} // namespace hppv
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <memory> // std::shared_ptr
+#include <vector>
+#include <deque>
+#include <functional> // std::function
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm> // std::min
+#include <initializer_list>
+
+namespace hppv
+{
+
+// a work-stealing thread pool, see App::getJobs()
+//
+// auto load = jobs.schedule([]{...});
+// auto parse = jobs.schedule([]{...}, {load}); // runs after load
+// jobs.wait(parse);
+//
+// jobs.parallelFor(count, [](int first, int last){...});
+//
+// every thread has its own queue, it takes the newest jobs from it
+// and steals the oldest ones from the others, the threads waiting
+// in wait(), waitAll() and parallelFor() execute the jobs too
+
+class Jobs
+{
+    struct Job;
+
+public:
+    using Function = std::function<void()>;
+
+    // keeps the job alive, can be used as a dependency after the job is done
+    using Id = std::shared_ptr<Job>;
+
+    // numThreads == 0 - std::thread::hardware_concurrency(),
+    // the number of the worker threads is numThreads - 1 (the waiting thread works too)
+    explicit Jobs(int numThreads = 0);
+
+    // waits for all the jobs
+    ~Jobs();
+
+    Jobs(const Jobs&) = delete;
+    Jobs& operator=(const Jobs&) = delete;
+
+    // the function runs after all the dependencies are done
+    Id schedule(Function function, std::initializer_list<Id> dependencies = {});
+    Id schedule(Function function, const std::vector<Id>& dependencies);
+
+    void wait(const Id& id);
+
+    // waits for all the scheduled jobs (including the ones scheduled meanwhile)
+    void waitAll();
+
+    bool isDone(const Id& id) const;
+
+    // calls f(first, last) on the chunks of [0, count) and waits for all of them,
+    // chunkSize == 0 - a few chunks per thread
+    template<typename F>
+    void parallelFor(int count, const F& f, int chunkSize = 0);
+
+    int getNumThreads() const {return threads_.size() + 1;}
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Id> jobs;
+    };
+
+    // queues_[0] is shared by the threads that are not workers
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::atomic_int numQueued_ = 0;
+    std::atomic_int numUnfinished_ = 0;
+    std::atomic_int numWaiting_ = 0;
+
+    // sleeping workers and waiting threads
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool quit_ = false;
+
+    std::vector<std::thread> threads_;
+
+    void push(Id job);
+    Id pop();
+    void execute(const Id& job);
+
+    // executes the jobs until predicate() is true
+    template<typename P>
+    void waitUntil(const P& predicate);
+
+    void work(int queue);
+};
+
+template<typename F>
+void Jobs::parallelFor(const int count, const F& f, int chunkSize)
+{
+    if(count <= 0)
+        return;
+
+    if(chunkSize <= 0)
+    {
+        chunkSize = std::max(1, count / (getNumThreads() * 4));
+    }
+
+    const auto numChunks = (count + chunkSize - 1) / chunkSize;
+    std::atomic_int next = 0;
+
+    const auto run = [&next, count, chunkSize, numChunks, &f]
+    {
+        for(int chunk; (chunk = next++) < numChunks;)
+        {
+            const auto first = chunk * chunkSize;
+            f(first, std::min(first + chunkSize, count));
+        }
+    };
+
+    std::vector<Id> ids;
+
+    for(auto i = 1; i < std::min(numChunks, getNumThreads()); ++i)
+    {
+        ids.push_back(schedule(run));
+    }
+
+    run();
+
+    for(const auto& id: ids)
+    {
+        wait(id);
+    }
+}
+
+} // namespace hppv
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <optional>
 
 #include <glm/vec2.hpp>
@@ -13,6 +14,7 @@
 #include "GLobjects.hpp"
 #include "Shader.hpp"
 #include "Texture.hpp"
+#include "TextureAtlas.hpp"
 
 using GLint = int;
 
@@ -61,6 +63,8 @@ struct Circle
     // OpenGL texCoords are calculated based on this
     // and the last registered texture (if Renderer::normalizeTexRect == true)
     glm::vec4 texRect = {0.f, 0.f, 1.f, 1.f};
+
+    int layer = 0; // Render::CircleTexArray
 };
 
 struct Sprite
@@ -84,6 +88,12 @@ struct Sprite
         size(space.size)
     {}
 
+    // renderer.texture(atlas.getPage(image)) must be set
+    explicit Sprite(const AtlasImage& image):
+        size(image.size),
+        texRect(image.texRect)
+    {}
+
     glm::vec4 toVec4() const {return {pos, size};}
     Space toSpace() const {return Space(toVec4());}
 
@@ -93,6 +103,7 @@ struct Sprite
     float rotation = 0.f;
     glm::vec2 rotationPoint = {0.f, 0.f};
     glm::vec4 texRect = {0.f, 0.f, 1.f, 1.f};
+    int layer = 0; // Render::TexArray
 };
 
 struct Vertex
@@ -120,14 +131,19 @@ enum class Render
     SdfGlow = 7, // vec4 glowColor; float glowWidth [0.0, 0.5]
     SdfShadow = 8, // vec4 shadowColor; float shadowSmoothing [0.0, 0.5]; vec2 shadowOffset ((1.0, 1.0) - offset by texture size)
     VerticesColor = 9,
-    VerticesTex = 10
+    VerticesTex = 10,
+
+    // sprites using different layers of a Texture::Array can be rendered in one batch
+    TexArray = 11,
+    CircleTexArray = 12
 };
 
 // GL_TEXTURE_WRAP_S/T == GL_CLAMP_TO_EDGE
 enum class Sample
 {
     Linear,
-    Nearest
+    Nearest,
+    Trilinear // GL_LINEAR_MIPMAP_LINEAR, see Texture mipmaps
 };
 
 // * state changes on non-empty batch break it
@@ -163,6 +179,23 @@ public:
     void scissor(glm::ivec4 scissor);
     void disableScissor() {getBatchToUpdate().scissor.reset();}
 
+    // ----- stencil clipping, disabled by default
+
+    // needs a stencil buffer - the default framebuffer (cleared by App every frame)
+    // or a Framebuffer with the depth-stencil attachment (cleared in clear())
+
+    // the color output is disabled, every rasterized fragment of the clip shape
+    // writes the value (alpha is ignored, use Vertices or Render::Color sprites)
+    void stencilWrite(int value = 1) {setStencil(Stencil::Write, value);}
+
+    // only the fragments where stencil == value (!= value if inverted) pass
+    void stencilTest(int value = 1, bool inverted = false)
+    {
+        setStencil(inverted ? Stencil::NotEqual : Stencil::Equal, value);
+    }
+
+    void disableStencil() {setStencil(Stencil::Disabled, 0);}
+
     // -----
 
     void viewport(glm::ivec4 viewport);
@@ -176,7 +209,15 @@ public:
     // ----- default is Render::Color
 
     void shader(Shader& shader) {getBatchToUpdate().shader = &shader;}
-    void shader(Render mode);
+
+    // each mode and fragment shader options combination uses a specialised program,
+    // compiled on the first use
+    void shader(Render mode)
+    {
+        auto& batch = getBatchToUpdate();
+        batch.shader = nullptr;
+        batch.mode = mode;
+    }
 
     // -----
 
@@ -192,10 +233,7 @@ public:
     void texture(Texture& texture, GLenum unit = 0);
     void sampler(GLsampler& sampler, GLenum unit = 0);
 
-    void sampler(Sample mode, GLenum unit = 0)
-    {
-        sampler(mode == Sample::Linear ? samplerLinear_ : samplerNearest_, unit);
-    }
+    void sampler(Sample mode, GLenum unit = 0);
 
     // ----- default is GL_ONE, GL_ONE_MINUS_SRC_ALPHA
 
@@ -212,6 +250,7 @@ public:
 
     // good for rendering rotated sprites,
     // not so good when one sprite must perfectly cover the other
+    // (not needed when rendering to a multisample Framebuffer)
 
     void antialiasedSprites(bool on) {getBatchToUpdate().antialiasedSprites = on;}
 
@@ -229,10 +268,19 @@ public:
     void cache(const Circle& circle) {cache(&circle, 1);}
     void cache(const Sprite* sprite, std::size_t count);
     void cache(const Circle* circle, std::size_t count);
-    void cache(const Text& text);
+    void cache(const Text& text) {cache(&text, 1);}
+    void cache(const Text* text, std::size_t count);
+
+    // labels - all share the font, scale, color and rotation of the text,
+    // text.text and text.pos are ignored
+    void cache(const Text& text, const std::string_view* strings, const glm::vec2* positions, std::size_t count);
     void cache(const Vertex& vertex) {cache(&vertex, 1);}
     void cache(const Vertex* vertex, std::size_t count);
 
+    // instances stored in a buffer object (e.g. written by a shader, see GpuParticles),
+    // each element starts with the Instance, the buffer is read in flush()
+    void cache(GLbo& instances, std::size_t count, std::size_t stride = sizeof(Instance));
+
     // -----
 
     void flush();
@@ -246,6 +294,7 @@ public:
     // out vec4 vColor;
     // out vec2 vTexCoord;
     // out vec2 vPos; // [0.0, 1.0], y grows down
+    // out float vLayer;
 
     static const char* const vInstancesSource;
 
@@ -261,6 +310,7 @@ public:
         glm::mat4 matrix;
         glm::vec4 color;
         glm::vec4 normTexRect;
+        float layer;
     };
 
 private:
@@ -270,15 +320,20 @@ private:
         ReservedInstances = 100000,
         ReservedTexUnits = 50,
         ReservedUniforms = 50,
-        ReservedVertices = 50000
+        ReservedVertices = 50000,
+        NumModes = 13,
+        NumShaderOptions = 4 // premultiplyAlpha | antialiasedSprites << 1
     };
 
     GLvao vaoInstances_, vaoVertices_;
+    GLvao vaoInstancesBuffer_; // for cache(GLbo&, ...)
     GLbo boQuad_, boInstances_, boVertices_;
-    Shader shaderBasic_, shaderSdf_, shaderVertices_;
+    ShaderVariants shadersBasic_, shadersSdf_, shadersVertices_;
+    Shader* shaders_[NumModes][NumShaderOptions] = {}; // nullptr - not used yet
     Texture texDummy_;
     GLsampler samplerLinear_;
     GLsampler samplerNearest_;
+    GLsampler samplerTrilinear_;
 
     struct TexUnit
     {
@@ -315,15 +370,28 @@ private:
         };
     };
 
+    enum class Stencil
+    {
+        Disabled,
+        Write,
+        Equal,
+        NotEqual
+    };
+
     // viewport and scissor have y component in the OpenGL coordinate system
     struct Batch
     {
         GLenum primitive;
         GLvao* vao;
+        GLbo* instancesBuffer; // nullptr - instances_
+        std::size_t instancesStride;
         std::optional<glm::ivec4> scissor;
+        Stencil stencil;
+        int stencilValue;
         glm::ivec4 viewport;
         Space projection;
-        Shader* shader;
+        Shader* shader; // nullptr - built-in
+        Render mode;
         GLenum srcAlpha;
         GLenum dstAlpha;
         bool premultiplyAlpha;
@@ -348,6 +416,17 @@ private:
 
     void setTexUnitsDefault();
     Batch& getBatchToUpdate();
+
+    // the instance vao and GL_ARRAY_BUFFER must be bound
+    void setInstanceAttributes(std::size_t stride);
+    Shader& getShader(Render mode, bool premultiplyAlpha, bool antialiasedSprites);
+
+    void setStencil(Stencil stencil, int value)
+    {
+        auto& batch = getBatchToUpdate();
+        batch.stencil = stencil;
+        batch.stencilValue = value;
+    }
 };
 
 } // namespace hppv
@@ -25,6 +25,7 @@ public:
     // called every frame on the top scene
     virtual void processInput(const std::vector<Event>&) {}
 
+    // the jobs scheduled with App::getJobs() are done before render()
     virtual void update() {}
 
     // App: renderer.viewport(scene);
@@ -25,16 +25,42 @@
 // ...
 
 // #include only works when a shader is loaded from a file,
-// might be placed anywhere
+// might be placed anywhere; the parsed files are cached (reloads only read the modified files),
+// a file that could not be loaded is reported and replaced with nothing,
+// an include cycle fails the whole load (the Shader is invalid);
+// after #version the includes placed on their own line are marked with #line directives
+// (source string number - index of the file, the files are printed on a compilation error)
+
+// hot reload: on Linux the file and all the included files are watched with inotify
+// on a background thread, bind() only checks a flag; elsewhere bind() checks
+// the last write time of the main file
+
+// program binary cache (ARB_get_program_binary), disabled by default:
+// Shader::setBinaryCacheDir("shader_cache");
+// the binaries are keyed by the sources and the GL vendor, renderer and version,
+// on any cache failure the sources are compiled
+
+// deferred compilation, disabled by default:
+// Shader::setDeferredCompilation(true);
+// the constructors only start the compilation and linking, the status is checked
+// in finishCompilation(), called on the first use (bind(), getUniformId(), ...);
+// with KHR_parallel_shader_compile the driver compiles in the background threads,
+// see getNumCompiling()
+
+// permutations: defines (e.g. "#define MODE 2\n") are inserted after the #version
+// line of every stage (at the beginning if there is none), ShaderVariants compiles
+// the permutations of the same sources lazily and caches them
 
 // code is exception free
 
 #pragma once
 
 #include <string>
-#include <set>
 #include <map>
 #include <initializer_list>
+#include <memory> // std::unique_ptr, std::shared_ptr
+#include <atomic>
+#include <vector>
 #include <experimental/filesystem>
 #include <string_view>
 #include <cassert>
@@ -60,18 +86,53 @@ public:
     struct File {};
 
     Shader() = default;
-    Shader(File, const std::string& filename, bool hotReload = false);
-    Shader(std::initializer_list<std::string_view> sources, std::string_view id);
+    Shader(File, const std::string& filename, bool hotReload = false, std::string_view defines = {});
+
+    // feedbackVaryings - transform feedback, captured in this order with GL_INTERLEAVED_ATTRIBS
+    Shader(std::initializer_list<std::string_view> sources, std::string_view id, std::string_view defines = {},
+           const std::vector<std::string>& feedbackVaryings = {});
+
+    // empty - disabled, the directory is created if needed
+    static void setBinaryCacheDir(const std::string& dir) {binaryCacheDir_ = dir;}
+
+    // number of the programs loaded from the binary cache so far
+    static int getNumBinaryCacheLoads() {return numBinaryCacheLoads_;}
+
+    // affects the constructors only, reload() is always synchronous
+    static void setDeferredCompilation(bool on) {deferredCompilation_ = on;}
+
+    // number of the deferred programs the driver is still working on,
+    // does not block (always 0 without KHR_parallel_shader_compile)
+    static int getNumCompiling();
 
     const std::string& getId() const {return id_;}
 
+    // blocks until the deferred compilation is finished, the first use calls it
+    void finishCompilation() {if(pendingProgram_) finishCompilation(std::move(pendingProgram_));}
+
+    // false while the deferred compilation is pending, see finishCompilation()
     bool isValid() const {return program_.getId();}
 
-    GLint getUniformLocation(std::string_view name);
+    // false if the deferred compilation is in progress (the first use would block)
+    bool isReady() const;
+
+    // index to the uniform table, for the hot loops (no name lookup)
+    // valid for the lifetime of the Shader, also after the reloads
+    struct UniformId
+    {
+        int index;
+    };
+
+    // the names are interned when the program is linked (a flat hash table),
+    // an unknown name is added as an inactive uniform
+    UniformId getUniformId(std::string_view name);
+
+    GLint getUniformLocation(std::string_view name) {return getUniformLocation(getUniformId(name));}
+    GLint getUniformLocation(UniformId id) const {return uniforms_[id.index].location;}
 
     // after successful reload:
     // * shader must be rebound
-    // * all uniform locations are invalidated
+    // * all uniform locations are invalidated (UniformIds are not)
     //
     // on failure:
     // * previous state remains
@@ -89,15 +150,27 @@ public:
     void uniform4f(std::string_view name, const float* value);
     void uniformMat4f(std::string_view name, const float* value);
 
+    void uniform1i(UniformId id, int value);
+    void uniform1f(UniformId id, float value);
+    void uniform2f(UniformId id, const float* value);
+    void uniform3f(UniformId id, const float* value);
+    void uniform4f(UniformId id, const float* value);
+    void uniformMat4f(UniformId id, const float* value);
+
 #ifdef SHADER_GLM
     void uniform2f(std::string_view name, glm::vec2 value) {uniform2f(name, &value.x);}
     void uniform3f(std::string_view name, glm::vec3 value) {uniform3f(name, &value.x);}
     void uniform4f(std::string_view name, glm::vec4 value) {uniform4f(name, &value.x);}
     void uniformMat4f(std::string_view name, const glm::mat4& value) {uniformMat4f(name, &value[0][0]);}
+
+    void uniform2f(UniformId id, glm::vec2 value) {uniform2f(id, &value.x);}
+    void uniform3f(UniformId id, glm::vec3 value) {uniform3f(id, &value.x);}
+    void uniform4f(UniformId id, glm::vec4 value) {uniform4f(id, &value.x);}
+    void uniformMat4f(UniformId id, const glm::mat4& value) {uniformMat4f(id, &value[0][0]);}
 #endif
 
 private:
-    enum {MaxUniforms = 256, InactiveUniform = 666};
+    enum {MaxUniforms = 256, InactiveUniform = 666, MinUniformTableSize = 16};
 
     class Program
     {
@@ -126,15 +199,95 @@ private:
         void clean();
     };
 
+    static inline std::string binaryCacheDir_;
+    static inline int numBinaryCacheLoads_ = 0;
+
+    struct PendingShader
+    {
+        GLuint id;
+        std::string_view typeName;
+        std::string source; // for the error message
+    };
+
+    // all the objects are deleted in the destructor
+    struct PendingProgram
+    {
+        PendingProgram();
+        ~PendingProgram();
+        PendingProgram(const PendingProgram&) = delete;
+        PendingProgram& operator=(const PendingProgram&) = delete;
+
+        GLuint program = 0;
+        std::vector<PendingShader> shaders;
+        std::string cacheFilename; // empty - no binary cache
+    };
+
+    static inline bool deferredCompilation_ = false;
+    static inline std::vector<PendingProgram*> pendingPrograms_;
+
     std::string id_;
+    std::string defines_;
+    std::vector<std::string> feedbackVaryings_;
     bool hotReload_ = false;
     Program program_;
+    std::unique_ptr<PendingProgram> pendingProgram_;
     fs::file_time_type fileLastWriteTime_;
-    std::map<std::string, GLint, std::less<>> uniformLocations_;
-    std::set<std::string, std::less<>> inactiveUniforms_;
+
+    // hot reload, set by the file watcher thread
+    std::shared_ptr<std::atomic<bool>> filesModified_;
+
+    // the #line source string numbers
+    std::vector<fs::path> sourceFiles_;
+
+    struct Uniform
+    {
+        std::string name;
+        GLint location; // InactiveUniform if not in the current program
+    };
+
+    std::vector<Uniform> uniforms_; // UniformId::index, never shrinks
+
+    // open addressing with linear probing, indices to uniforms_ (-1 - empty slot),
+    // the size is a power of two, at most half full
+    std::vector<int> uniformTable_;
+
+    // returns the slot with the name or the empty slot where it belongs
+    int& findUniform(std::string_view name);
+
+    // returns the index
+    int addUniform(std::string_view name, GLint location);
 
     // returns true on success
     bool swapProgram(std::initializer_list<std::string_view> sources);
+
+    // returns nullptr if the program binary was loaded from the cache (program_ is set)
+    std::unique_ptr<PendingProgram> startCompilation(std::initializer_list<std::string_view> sources);
+
+    // returns true on success
+    bool finishCompilation(std::unique_ptr<PendingProgram> pendingProgram);
+
+    void setProgram(GLuint program);
+
+    // hot reload, returns the source
+    std::string loadAndWatch();
+};
+
+class ShaderVariants
+{
+public:
+    ShaderVariants() = default;
+    ShaderVariants(std::initializer_list<std::string_view> sources, std::string_view id);
+
+    // compiles the permutation on the first call
+    // the reference stays valid for the lifetime of this object
+    Shader& get(const std::string& defines);
+
+    int getNumVariants() const {return variants_.size();}
+
+private:
+    std::string source_; // all the sources concatenated
+    std::string id_;
+    std::map<std::string, std::unique_ptr<Shader>, std::less<>> variants_;
 };
 
 } // namespace hppv
@@ -145,9 +298,20 @@ private:
 #include <iomanip> // std::setw
 #include <fstream>
 #include <sstream>
-#include <algorithm> // std::sort
+#include <algorithm> // std::sort, std::replace, std::max, std::any_of
 #include <vector>
 #include <optional>
+#include <cstdint>
+#include <cstdio> // std::snprintf
+#include <cstdlib> // std::atoi
+
+#ifdef __linux__
+#include <thread>
+#include <mutex>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
 
 namespace hppv
 {
@@ -170,104 +334,579 @@ void printMissingQuoteError(const fs::path& path)
     std::cout << "Shader: include directive - \" missing, file = " << path << std::endl;
 }
 
-std::string loadSourceFromFile(const fs::path& path)
+bool startsWith(const std::string_view str, const std::string_view prefix)
 {
-    std::ifstream file(path);
+    return str.substr(0, prefix.size()) == prefix;
+}
 
-    if(!file.is_open())
+bool isWhitespace(const std::string_view str)
+{
+    return str.find_first_not_of(" \t\r\n") == std::string::npos;
+}
+
+// #include preprocessor, GL thread only
+// * the parsed files are cached, a file is parsed again only if its last write time or size changed
+// * the source is built in one pass
+// * after #version the #line directives are emitted around the includes placed on their own line,
+//   source string number is the index in the files list
+// * a file that could not be loaded is replaced with nothing, a cycle fails the whole load
+
+class Preprocessor
+{
+public:
+    static Preprocessor& get()
     {
-        std::cout << "Shader: could not open file = " << path << std::endl;
-        return {};
+        static Preprocessor preprocessor;
+        return preprocessor;
+    }
+
+    // returns an empty string on failure
+    // files - if not nullptr, all the opened files are added (once)
+    std::string process(const fs::path& path, std::vector<fs::path>* const files)
+    {
+        State state;
+        const auto expanded = expand(path, state, false) && !state.cycle;
+
+        // also on failure, so the hot reload picks up the fix
+        if(files)
+        {
+            files->insert(files->end(), state.files.begin(), state.files.end());
+        }
+
+        if(!expanded)
+            return {};
+
+        return std::move(state.source);
     }
 
-    std::stringstream stringstream;
-    stringstream << file.rdbuf();
-    auto source = stringstream.str();
+private:
+    // the file is split after the #version lines and at the include directives
+    struct Chunk
+    {
+        std::string text;
+        bool stage = false; // contains a shader type directive
+        int version = 0; // ends with the #version line
+        fs::path include; // empty - none, included after the text
+        bool includeOwnLine = false;
+        int nextLine; // of the text that follows
+    };
+
+    struct File
+    {
+        fs::file_time_type lastWriteTime;
+        std::uintmax_t size;
+        std::vector<Chunk> chunks;
+    };
+
+    struct State
+    {
+        std::string source;
+        std::vector<fs::path> files;
+        std::vector<std::string> keys; // of the files
+        std::vector<std::string> stack; // keys, for the cycle detection
+        bool cycle = false;
+        bool afterVersion = false;
+        int version = 0;
+    };
+
+    std::map<std::string, File> files_; // the key is the canonical path
+
+    Preprocessor() = default;
 
-    const std::string_view includeDirective = "#include";
+    static std::string getKey(const fs::path& path)
+    {
+        std::error_code ec;
+        const auto canonical = fs::canonical(path, ec);
+        return ec ? path.string() : canonical.string();
+    }
 
-    std::size_t includeStart = 0;
-    while((includeStart = source.find(includeDirective, includeStart)) != std::string::npos)
+    static std::optional<File> parse(const fs::path& path, const std::string& text)
     {
-        const auto quoteStart = source.find('"', includeStart + includeDirective.size());
+        const std::string_view includeDirective = "#include";
 
-        if(quoteStart == std::string::npos)
+        File file;
+        Chunk chunk;
+        auto line = 0;
+        std::size_t pos = 0;
+
+        while(pos < text.size())
         {
-            printMissingQuoteError(path);
-            return {};
+            const auto end = text.find('\n', pos);
+            const auto lineEnd = (end == std::string::npos) ? text.size() : end + 1;
+            const auto lineStr = std::string_view(text).substr(pos, lineEnd - pos);
+            pos = lineEnd;
+            ++line;
+
+            std::size_t includeEnd = 0;
+
+            for(auto includeStart = lineStr.find(includeDirective); includeStart != std::string::npos;
+                includeStart = lineStr.find(includeDirective, includeEnd))
+            {
+                const auto pathStart = lineStr.find('"', includeStart + includeDirective.size());
+                const auto pathEnd = (pathStart == std::string::npos) ? pathStart : lineStr.find('"', pathStart + 1);
+
+                if(pathEnd == std::string::npos)
+                {
+                    printMissingQuoteError(path);
+                    return {};
+                }
+
+                chunk.text.append(lineStr.substr(includeEnd, includeStart - includeEnd));
+                chunk.include = lineStr.substr(pathStart + 1, pathEnd - pathStart - 1);
+
+                chunk.includeOwnLine = isWhitespace(lineStr.substr(0, includeStart)) &&
+                                       isWhitespace(lineStr.substr(pathEnd + 1));
+
+                chunk.nextLine = line; // the rest of the line
+                file.chunks.push_back(std::move(chunk));
+                chunk = {};
+                includeEnd = pathEnd + 1;
+            }
+
+            chunk.text.append(lineStr.substr(includeEnd));
+
+            if(includeEnd)
+                continue;
+
+            auto trimmed = lineStr;
+            trimmed.remove_prefix(std::min(trimmed.find_first_not_of(" \t"), trimmed.size()));
+
+            for(const auto directive: {"#vertex", "#geometry", "#fragment", "#compute"})
+            {
+                if(startsWith(trimmed, directive))
+                {
+                    chunk.stage = true;
+                }
+            }
+
+            if(startsWith(trimmed, "#version"))
+            {
+                chunk.version = std::atoi(std::string(trimmed.substr(8)).c_str());
+                chunk.nextLine = line + 1;
+                file.chunks.push_back(std::move(chunk));
+                chunk = {};
+            }
         }
 
-        const auto pathStart = quoteStart + 1;
-        const auto pathEnd = source.find('"', pathStart);
+        file.chunks.push_back(std::move(chunk));
+        return file;
+    }
+
+    // returns nullptr on failure
+    const File* load(const fs::path& path, const std::string& key)
+    {
+        std::error_code ec;
+        const auto lastWriteTime = fs::last_write_time(path, ec);
+        const auto size = ec ? 0 : fs::file_size(path, ec);
 
-        if(pathEnd == std::string::npos)
+        if(ec)
         {
-            printMissingQuoteError(path);
-            return {};
+            std::cout << "Shader: could not open file = " << path << std::endl;
+            return nullptr;
+        }
+
+        if(const auto it = files_.find(key);
+           it != files_.end() && it->second.lastWriteTime == lastWriteTime && it->second.size == size)
+        {
+            return &it->second;
         }
 
-        const fs::path includePath(source.substr(pathStart, pathEnd - pathStart));
-        std::string includedStr;
+        files_.erase(key);
 
-        if(includePath.is_absolute())
+        std::ifstream fileStream(path);
+
+        if(!fileStream.is_open())
         {
-            includedStr = loadSourceFromFile(includePath);
+            std::cout << "Shader: could not open file = " << path << std::endl;
+            return nullptr;
         }
-        else
+
+        std::stringstream stringstream;
+        stringstream << fileStream.rdbuf();
+        auto file = parse(path, stringstream.str());
+
+        if(!file)
+            return nullptr;
+
+        file->lastWriteTime = lastWriteTime;
+        file->size = size;
+        return &(files_[key] = std::move(*file));
+    }
+
+    static void emitLine(State& state, const int line, const int sourceNumber)
+    {
+        if(state.source.size() && state.source.back() != '\n')
+        {
+            state.source.push_back('\n');
+        }
+
+        // before GLSL 4.30 the line after the directive is line + 1
+        const auto offset = state.version < 430 ? 1 : 0;
+
+        state.source += "#line " + std::to_string(line - offset) + ' ' + std::to_string(sourceNumber) + '\n';
+    }
+
+    // ownLine - the include directive was on its own line (#line directives can be emitted)
+    bool expand(const fs::path& path, State& state, const bool ownLine)
+    {
+        const auto key = getKey(path);
+
+        if(std::find(state.stack.begin(), state.stack.end(), key) != state.stack.end())
+        {
+            std::cout << "Shader: include cycle, file = " << path << std::endl;
+            state.cycle = true;
+            return false;
+        }
+
+        const auto* const file = load(path, key);
+
+        if(!file)
+            return false;
+
+        int sourceNumber = std::find(state.keys.begin(), state.keys.end(), key) - state.keys.begin();
+
+        if(sourceNumber == static_cast<int>(state.keys.size()))
+        {
+            state.keys.push_back(key);
+            state.files.push_back(path);
+        }
+
+        state.stack.push_back(key);
+
+        if(ownLine && state.afterVersion)
+        {
+            emitLine(state, 1, sourceNumber);
+        }
+
+        for(const auto& chunk: file->chunks)
+        {
+            state.source += chunk.text;
+
+            if(chunk.stage)
+            {
+                state.afterVersion = false;
+            }
+
+            if(chunk.version)
+            {
+                state.afterVersion = true;
+                state.version = chunk.version;
+                emitLine(state, chunk.nextLine, sourceNumber);
+            }
+
+            if(!chunk.include.empty())
+            {
+                const auto includePath = chunk.include.is_absolute() ? chunk.include
+                                                                     : path.parent_path() / chunk.include;
+
+                // on failure the file is replaced with nothing (see State::cycle)
+                const auto included = expand(includePath, state, chunk.includeOwnLine);
+
+                if(included && chunk.includeOwnLine && state.afterVersion)
+                {
+                    emitLine(state, chunk.nextLine, sourceNumber);
+                }
+            }
+        }
+
+        state.stack.pop_back();
+        return true;
+    }
+};
+
+// files - if not nullptr, all the opened files are added
+std::string loadSourceFromFile(const fs::path& path, std::vector<fs::path>* const files = nullptr)
+{
+    return Preprocessor::get().process(path, files);
+}
+
+#ifdef __linux__
+
+// the parent directories are watched (editors often replace the file instead of writing to it)
+
+class FileWatcher
+{
+public:
+    static FileWatcher& get()
+    {
+        static FileWatcher fileWatcher;
+        return fileWatcher;
+    }
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    ~FileWatcher()
+    {
+        if(thread_.joinable())
+        {
+            const char quit = 0;
+            [[maybe_unused]] const auto ret = write(pipe_[1], &quit, 1);
+            thread_.join();
+        }
+
+        for(const auto fd: {fd_, pipe_[0], pipe_[1]})
+        {
+            if(fd != -1)
+                close(fd);
+        }
+    }
+
+    // replaces the previously watched files of the flag
+    void watch(const std::vector<fs::path>& files, const std::shared_ptr<std::atomic<bool>>& flag)
+    {
+        if(!thread_.joinable())
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        entries_.erase(std::remove_if(entries_.begin(), entries_.end(), [&flag](const Entry& entry)
+        {
+            const auto entryFlag = entry.flag.lock();
+            return !entryFlag || entryFlag == flag;
+        }), entries_.end());
+
+        for(const auto& file: files)
+        {
+            std::error_code ec;
+            auto path = fs::canonical(file, ec);
+
+            if(ec)
+                continue;
+
+            const auto dir = path.parent_path();
+            const auto wd = inotify_add_watch(fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+
+            if(wd == -1)
+            {
+                std::cout << "Shader: inotify_add_watch() failed, dir = " << dir << std::endl;
+                continue;
+            }
+
+            // the same wd is returned for the already watched directory
+            dirs_[wd] = dir;
+            entries_.push_back({std::move(path), flag, wd});
+        }
+
+        // remove the watches of the directories with no entries left
+        for(auto it = dirs_.begin(); it != dirs_.end();)
         {
-            includedStr = loadSourceFromFile(path.parent_path() /= includePath);
+            const auto wd = it->first;
+
+            if(std::any_of(entries_.begin(), entries_.end(), [wd](const Entry& entry){return entry.wd == wd;}))
+            {
+                ++it;
+                continue;
+            }
+
+            inotify_rm_watch(fd_, wd);
+            it = dirs_.erase(it);
         }
+    }
+
+private:
+    struct Entry
+    {
+        fs::path file;
+        std::weak_ptr<std::atomic<bool>> flag;
+        int wd;
+    };
+
+    int fd_ = -1;
+    int pipe_[2] = {-1, -1}; // wakes up the thread on destruction
+    std::thread thread_;
+
+    std::mutex mutex_;
+    std::map<int, fs::path> dirs_;
+    std::vector<Entry> entries_;
 
-        const auto addSize = includedStr.size();
-        source.erase(includeStart, pathEnd + 1 - includeStart);
-        source.insert(includeStart, std::move(includedStr));
-        includeStart += addSize;
+    FileWatcher()
+    {
+        fd_ = inotify_init1(IN_CLOEXEC);
+
+        if(fd_ == -1 || pipe(pipe_) == -1)
+        {
+            std::cout << "Shader: inotify_init1() or pipe() failed, hot reload disabled" << std::endl;
+            return;
+        }
+
+        thread_ = std::thread(&FileWatcher::work, this);
     }
 
+    void work()
+    {
+        pollfd fds[] = {{fd_, POLLIN, 0}, {pipe_[0], POLLIN, 0}};
+
+        for(;;)
+        {
+            if(poll(fds, 2, -1) == -1)
+                continue; // EINTR
+
+            if(fds[1].revents)
+                return;
+
+            alignas(inotify_event) char buffer[4096];
+            const auto length = read(fd_, buffer, sizeof(buffer));
+
+            if(length <= 0)
+                continue;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            for(auto* ptr = buffer; ptr < buffer + length;)
+            {
+                const auto& event = *reinterpret_cast<const inotify_event*>(ptr);
+                ptr += sizeof(inotify_event) + event.len;
+
+                if(!event.len)
+                    continue;
+
+                const auto it = dirs_.find(event.wd);
+
+                if(it == dirs_.end())
+                    continue;
+
+                const auto path = it->second / event.name;
+
+                for(const auto& entry: entries_)
+                {
+                    if(entry.file == path)
+                    {
+                        if(const auto flag = entry.flag.lock())
+                        {
+                            *flag = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+#endif // __linux__
+
+std::string Shader::loadAndWatch()
+{
+    std::vector<fs::path> files;
+    auto source = loadSourceFromFile(id_, &files);
+    sourceFiles_ = files;
+
+#ifdef __linux__
+    if(hotReload_)
+    {
+        if(!filesModified_)
+        {
+            filesModified_ = std::make_shared<std::atomic<bool>>(false);
+        }
+
+        // the include graph might have changed
+        FileWatcher::get().watch(files, filesModified_);
+    }
+#endif
+
     return source;
 }
 
-Shader::Shader(File, const std::string& filename, const bool hotReload):
+Shader::Shader(File, const std::string& filename, const bool hotReload, const std::string_view defines):
     id_(filename),
+    defines_(defines),
     hotReload_(hotReload)
 {
     fileLastWriteTime_ = getFileLastWriteTime(filename);
 
-    if(const auto source = loadSourceFromFile(filename); source.size())
+    if(const auto source = loadAndWatch(); source.size())
+    {
+        if(deferredCompilation_)
+        {
+            pendingProgram_ = startCompilation({source});
+        }
+        else
+        {
+            swapProgram({source});
+        }
+    }
+}
+
+Shader::Shader(const std::initializer_list<std::string_view> sources, const std::string_view id,
+               const std::string_view defines, const std::vector<std::string>& feedbackVaryings):
+    id_(id),
+    defines_(defines),
+    feedbackVaryings_(feedbackVaryings)
+{
+    if(deferredCompilation_)
+    {
+        pendingProgram_ = startCompilation(sources);
+    }
+    else
     {
-        swapProgram({source});
+        swapProgram(sources);
     }
 }
 
-Shader::Shader(const std::initializer_list<std::string_view> sources, const std::string_view id):
-    id_(id)
+int& Shader::findUniform(const std::string_view name)
 {
-    swapProgram(sources);
+    if(uniformTable_.empty())
+    {
+        uniformTable_.assign(MinUniformTableSize, -1);
+    }
+
+    const auto mask = uniformTable_.size() - 1;
+    auto slot = std::hash<std::string_view>{}(name) & mask;
+
+    for(;;)
+    {
+        auto& index = uniformTable_[slot];
+
+        if(index == -1 || uniforms_[index].name == name)
+            return index;
+
+        slot = (slot + 1) & mask;
+    }
 }
 
-GLint Shader::getUniformLocation(const std::string_view name)
+int Shader::addUniform(const std::string_view name, const GLint location)
 {
-    const auto it = uniformLocations_.find(name);
+    const int index = uniforms_.size();
+    uniforms_.push_back({std::string(name), location});
+
+    if(uniforms_.size() * 2 > uniformTable_.size())
+    {
+        uniformTable_.assign(std::max<std::size_t>(MinUniformTableSize, uniformTable_.size() * 2), -1);
 
-    if(it == uniformLocations_.end() &&
-       inactiveUniforms_.find(name) == inactiveUniforms_.end())
+        for(auto i = 0; i <= index; ++i)
+        {
+            findUniform(uniforms_[i].name) = i;
+        }
+    }
+    else
     {
-        std::cout << "Shader, " << id_ << ": inactive uniform = " << name << std::endl;
-        inactiveUniforms_.emplace(name);
-        return InactiveUniform;
+        findUniform(name) = index;
     }
 
-    return it->second;
+    return index;
+}
+
+Shader::UniformId Shader::getUniformId(const std::string_view name)
+{
+    finishCompilation();
+
+    if(const auto index = findUniform(name); index != -1)
+        return {index};
+
+    std::cout << "Shader, " << id_ << ": inactive uniform = " << name << std::endl;
+    return {addUniform(name, InactiveUniform)};
 }
 
 void Shader::reload()
 {
+    finishCompilation();
+
     if(const auto time = getFileLastWriteTime(id_); time > fileLastWriteTime_)
     {
         fileLastWriteTime_ = time;
     }
 
-    if(const auto source = loadSourceFromFile(id_); source.size())
+    if(const auto source = loadAndWatch(); source.size())
     {
         if(swapProgram({source}))
         {
@@ -278,13 +917,25 @@ void Shader::reload()
 
 void Shader::bind()
 {
+    finishCompilation();
+
     if(hotReload_)
     {
-        if(const auto time = getFileLastWriteTime(id_); time > fileLastWriteTime_)
+#ifdef __linux__
+        const auto modified = filesModified_ && filesModified_->exchange(false);
+#else
+        const auto time = getFileLastWriteTime(id_);
+        const auto modified = time > fileLastWriteTime_;
+
+        if(modified)
         {
             fileLastWriteTime_ = time;
+        }
+#endif
 
-            if(const auto source = loadSourceFromFile(id_); source.size())
+        if(modified)
+        {
+            if(const auto source = loadAndWatch(); source.size())
             {
                 if(swapProgram({source}))
                 {
@@ -305,6 +956,14 @@ void Shader::uniform4f(const std::string_view name, const float* const value) {g
 void Shader::uniformMat4f(const std::string_view name, const float* const value) {glUniformMatrix4fv(getUniformLocation(name),
                                                                                                      1, GL_FALSE, value);}
 
+void Shader::uniform1i(const UniformId id, const int value) {glUniform1i(getUniformLocation(id), value);}
+void Shader::uniform1f(const UniformId id, const float value) {glUniform1f(getUniformLocation(id), value);}
+void Shader::uniform2f(const UniformId id, const float* const value) {glUniform2fv(getUniformLocation(id), 1, value);}
+void Shader::uniform3f(const UniformId id, const float* const value) {glUniform3fv(getUniformLocation(id), 1, value);}
+void Shader::uniform4f(const UniformId id, const float* const value) {glUniform4fv(getUniformLocation(id), 1, value);}
+void Shader::uniformMat4f(const UniformId id, const float* const value) {glUniformMatrix4fv(getUniformLocation(id),
+                                                                                           1, GL_FALSE, value);}
+
 void Shader::Program::clean() {if(id_) glDeleteProgram(id_);}
 
 template<bool isProgram>
@@ -353,6 +1012,37 @@ std::optional<std::string> getError(const GLuint id, const GLenum flag)
     return log;
 }
 
+std::string insertDefines(const std::string_view source, const std::string_view defines)
+{
+    std::size_t pos = 0;
+
+    if(const auto version = source.find("#version"); version != std::string::npos)
+    {
+        pos = source.find('\n', version);
+        pos = (pos == std::string::npos) ? source.size() : pos + 1;
+    }
+
+    std::string result;
+    result.reserve(source.size() + defines.size() + 1);
+    result.append(source.substr(0, pos));
+
+    // #version without the trailing newline
+    if(pos && source[pos - 1] != '\n')
+    {
+        result.push_back('\n');
+    }
+
+    result.append(defines);
+
+    if(defines.size() && defines.back() != '\n')
+    {
+        result.push_back('\n');
+    }
+
+    result.append(source.substr(pos));
+    return result;
+}
+
 // shader must be deleted with glDeleteShader()
 GLuint createAndCompileShader(const GLenum type, const std::string_view source)
 {
@@ -364,10 +1054,224 @@ GLuint createAndCompileShader(const GLenum type, const std::string_view source)
     return id;
 }
 
-// returns 0 on error
-// if return value != 0 program must be deleted with glDeleteProgram()
-GLuint createProgram(const std::initializer_list<std::string_view> sources, const std::string_view id)
+bool hasParallelShaderCompile()
+{
+    static const auto has = []
+    {
+        GLint numExtensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+
+        for(auto i = 0; i < numExtensions; ++i)
+        {
+            const std::string_view name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+
+            if(name == "GL_KHR_parallel_shader_compile" || name == "GL_ARB_parallel_shader_compile")
+                return true;
+        }
+
+        return false;
+    }();
+
+    return has;
+}
+
+Shader::PendingProgram::PendingProgram()
+{
+    pendingPrograms_.push_back(this);
+}
+
+Shader::PendingProgram::~PendingProgram()
+{
+    pendingPrograms_.erase(std::find(pendingPrograms_.begin(), pendingPrograms_.end(), this));
+
+    for(const auto& shader: shaders)
+    {
+        glDeleteShader(shader.id);
+    }
+
+    if(program)
+    {
+        glDeleteProgram(program);
+    }
+}
+
+int Shader::getNumCompiling()
+{
+    if(!hasParallelShaderCompile())
+        return 0;
+
+    auto count = 0;
+
+    for(const auto* const pendingProgram: pendingPrograms_)
+    {
+        GLint completed;
+        glGetProgramiv(pendingProgram->program, GL_COMPLETION_STATUS_KHR, &completed);
+        count += completed == GL_FALSE;
+    }
+
+    return count;
+}
+
+bool Shader::isReady() const
+{
+    if(!pendingProgram_ || !hasParallelShaderCompile())
+        return true;
+
+    GLint completed;
+    glGetProgramiv(pendingProgram_->program, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
+}
+
+void printCompilationError(const std::string_view id, const std::string_view typeName, const std::string_view error,
+                           const std::string_view shaderSource)
+{
+    std::cout << "Shader, " << id << ": " << typeName << " shader compilation failed\n"
+              << error << '\n';
+
+    std::cout.setf(std::cout.left);
+    std::size_t end = 0;
+    int line = 1;
+
+    for(;;)
+    {
+        const auto start = end;
+
+        if(end = shaderSource.find('\n', end); end != std::string::npos)
+        {
+            ++end;
+        }
+        else
+        {
+            std::cout << std::setw(5) << line << shaderSource.substr(start, end) << '\n';
+            break;
+        }
+
+        std::cout << std::setw(5) << line << shaderSource.substr(start, end - start);
+        ++line;
+    }
+
+    std::cout.flush();
+}
+
+// FNV-1a
+void hashAppend(std::uint64_t& hash, const std::string_view data)
+{
+    for(const auto c: data)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211u;
+    }
+
+    // separator, so {"ab", "c"} != {"a", "bc"}
+    hash ^= 0xff;
+    hash *= 1099511628211u;
+}
+
+std::string getBinaryCacheFilename(const std::string& dir, const std::initializer_list<std::string_view> sources,
+                                   const std::string_view defines, const std::vector<std::string>& feedbackVaryings)
+{
+    std::uint64_t hash = 14695981039346656037u;
+
+    for(const auto name: {GL_VENDOR, GL_RENDERER, GL_VERSION})
+    {
+        hashAppend(hash, reinterpret_cast<const char*>(glGetString(name)));
+    }
+
+    for(const auto source: sources)
+    {
+        hashAppend(hash, source);
+    }
+
+    hashAppend(hash, defines);
+
+    for(const auto& varying: feedbackVaryings)
+    {
+        hashAppend(hash, varying);
+    }
+
+    char filename[32];
+    std::snprintf(filename, sizeof(filename), "%016llx.bin", static_cast<unsigned long long>(hash));
+    return (fs::path(dir) / filename).string();
+}
+
+// returns 0 on failure
+GLuint loadProgramBinary(const std::string& filename)
 {
+    std::ifstream file(filename, std::ios::binary);
+
+    if(!file.is_open())
+        return 0;
+
+    GLenum format;
+    file.read(reinterpret_cast<char*>(&format), sizeof(format));
+    const std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if(!file.eof() || binary.empty())
+        return 0;
+
+    const auto program = glCreateProgram();
+    glProgramBinary(program, format, binary.data(), binary.size());
+
+    // e.g. the driver was updated and it does not tell it by the version string
+    if(getError<true>(program, GL_LINK_STATUS))
+    {
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+void saveProgramBinary(const std::string& filename, const GLuint program)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+    if(!length)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    std::error_code ec;
+    fs::create_directories(fs::path(filename).parent_path(), ec);
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+    file.write(binary.data(), binary.size());
+
+    if(!file)
+    {
+        std::cout << "Shader: could not write the program binary, file = " << filename << std::endl;
+    }
+}
+
+std::unique_ptr<Shader::PendingProgram> Shader::startCompilation(
+        const std::initializer_list<std::string_view> sources)
+{
+    auto pendingProgram = std::make_unique<PendingProgram>();
+
+    if(binaryCacheDir_.size() && glGetProgramBinary)
+    {
+        // 0 if ARB_get_program_binary is not supported (GL_INVALID_ENUM)
+        GLint numFormats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+
+        if(numFormats)
+        {
+            pendingProgram->cacheFilename = getBinaryCacheFilename(binaryCacheDir_, sources, defines_,
+                                                                  feedbackVaryings_);
+
+            if(const auto program = loadProgramBinary(pendingProgram->cacheFilename))
+            {
+                ++numBinaryCacheLoads_;
+                setProgram(program);
+                return nullptr;
+            }
+        }
+    }
+
     struct ShaderType
     {
         GLenum value;
@@ -386,11 +1290,9 @@ GLuint createProgram(const std::initializer_list<std::string_view> sources, cons
         ShaderType type;
     };
 
-    std::vector<GLuint> shaders;
-    bool compilationError = false;
-
     std::vector<ShaderData> shaderData;
 
+    // no status queries here, so the driver can compile in parallel
     for(const auto source: sources)
     {
         shaderData.clear();
@@ -420,91 +1322,119 @@ GLuint createProgram(const std::initializer_list<std::string_view> sources, cons
                 count = nextIt->start - nextIt->type.name.size() - it->start;
             }
 
-            const auto shaderSource = source.substr(it->start, count);
-            shaders.push_back(createAndCompileShader(it->type.value, shaderSource));
+            auto shaderSource = std::string(source.substr(it->start, count));
 
-            if(const auto error = getError<false>(shaders.back(), GL_COMPILE_STATUS))
+            if(defines_.size())
             {
-                std::cout << "Shader, " << id << ": " << it->type.name << " shader compilation failed\n"
-                          << *error << '\n';
+                shaderSource = insertDefines(shaderSource, defines_);
+            }
 
-                {
-                    std::cout.setf(std::cout.left);
-                    std::size_t end = 0;
-                    int line = 1;
+            pendingProgram->shaders.push_back({createAndCompileShader(it->type.value, shaderSource),
+                                               it->type.name, std::move(shaderSource)});
+        }
+    }
 
-                    for(;;)
-                    {
-                        const auto start = end;
+    const auto program = glCreateProgram();
+    pendingProgram->program = program;
 
-                        if(end = shaderSource.find('\n', end); end != std::string::npos)
-                        {
-                            ++end;
-                        }
-                        else
-                        {
-                            std::cout << std::setw(5) << line << shaderSource.substr(start, end) << '\n';
-                            break;
-                        }
+    for(const auto& shader: pendingProgram->shaders)
+    {
+        glAttachShader(program, shader.id);
+    }
 
-                        std::cout << std::setw(5) << line << shaderSource.substr(start, end - start);
-                        ++line;
-                    }
+    if(pendingProgram->cacheFilename.size())
+    {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
 
-                    std::cout.flush();
-                }
+    if(feedbackVaryings_.size())
+    {
+        std::vector<const char*> varyings;
 
-                compilationError = true;
-            }
+        for(const auto& varying: feedbackVaryings_)
+        {
+            varyings.push_back(varying.c_str());
+        }
+
+        glTransformFeedbackVaryings(program, varyings.size(), varyings.data(), GL_INTERLEAVED_ATTRIBS);
+    }
+
+    glLinkProgram(program);
+
+    return pendingProgram;
+}
+
+bool Shader::finishCompilation(const std::unique_ptr<PendingProgram> pendingProgram)
+{
+    if(!pendingProgram)
+        return true; // loaded from the cache
+
+    auto compilationError = false;
+
+    for(const auto& shader: pendingProgram->shaders)
+    {
+        if(const auto error = getError<false>(shader.id, GL_COMPILE_STATUS))
+        {
+            printCompilationError(id_, shader.typeName, *error, shader.source);
+            compilationError = true;
         }
     }
 
     if(compilationError)
     {
-        for(const auto shader: shaders)
+        if(sourceFiles_.size() > 1)
         {
-            glDeleteShader(shader);
+            std::cout << "Shader, " << id_ << ": source string numbers\n";
+
+            for(std::size_t i = 0; i < sourceFiles_.size(); ++i)
+            {
+                std::cout << std::setw(5) << i << sourceFiles_[i].string() << '\n';
+            }
+
+            std::cout.flush();
         }
 
-        return 0;
+        return false;
     }
 
-    const auto program = glCreateProgram();
+    const auto program = pendingProgram->program;
 
-    for(const auto shader: shaders)
+    if(const auto error = getError<true>(program, GL_LINK_STATUS))
     {
-        glAttachShader(program, shader);
+        std::cout << "Shader, " << id_ << ": program linking failed\n" << *error << std::endl;
+        return false;
     }
 
-    glLinkProgram(program);
-
-    for(const auto shader: shaders)
+    for(const auto& shader: pendingProgram->shaders)
     {
-        glDetachShader(program, shader);
-        glDeleteShader(shader);
+        glDetachShader(program, shader.id);
     }
 
-    if(const auto error = getError<true>(program, GL_LINK_STATUS))
+    if(pendingProgram->cacheFilename.size())
     {
-        std::cout << "Shader, " << id << ": program linking failed\n" << *error << std::endl;
-        glDeleteProgram(program);
-        return 0;
+        saveProgramBinary(pendingProgram->cacheFilename, program);
     }
 
-    return program;
+    // the ownership goes to program_
+    pendingProgram->program = 0;
+    setProgram(program);
+    return true;
 }
 
 bool Shader::swapProgram(const std::initializer_list<std::string_view> sources)
 {
-    const auto newProgram = createProgram(sources, id_);
-
-    if(!newProgram)
-        return false;
+    return finishCompilation(startCompilation(sources));
+}
 
-    program_ = Program(newProgram);
+void Shader::setProgram(const GLuint program)
+{
+    program_ = Program(program);
 
-    uniformLocations_.clear();
-    inactiveUniforms_.clear();
+    // the ids of the uniforms that are not in the new program remain valid
+    for(auto& uniform: uniforms_)
+    {
+        uniform.location = InactiveUniform;
+    }
 
     GLint numUniforms;
     glGetProgramiv(program_.getId(), GL_ACTIVE_UNIFORMS, &numUniforms);
@@ -519,11 +1449,55 @@ bool Shader::swapProgram(const std::initializer_list<std::string_view> sources)
         glGetActiveUniform(program_.getId(), i, uniformName.size(), nullptr, &dum1, &dum2,
                            uniformName.data());
 
-        const auto uniformLocation = glGetUniformLocation(program_.getId(), uniformName.data());
-        uniformLocations_[uniformName.data()] = uniformLocation;
+        const std::string_view name = uniformName.data();
+        const auto location = glGetUniformLocation(program_.getId(), uniformName.data());
+
+        if(const auto index = findUniform(name); index != -1)
+        {
+            uniforms_[index].location = location;
+        }
+        else
+        {
+            addUniform(name, location);
+        }
     }
+}
 
-    return true;
+ShaderVariants::ShaderVariants(const std::initializer_list<std::string_view> sources, const std::string_view id):
+    id_(id)
+{
+    // a single source might contain any number of the shader type directives
+    for(const auto source: sources)
+    {
+        source_.append(source);
+        source_.push_back('\n');
+    }
+}
+
+Shader& ShaderVariants::get(const std::string& defines)
+{
+    if(const auto it = variants_.find(defines); it != variants_.end())
+        return *it->second;
+
+    auto id = id_;
+
+    if(defines.size())
+    {
+        // one line, for the log messages
+        auto definesLine = defines;
+        std::replace(definesLine.begin(), definesLine.end(), '\n', ' ');
+
+        while(definesLine.size() && definesLine.back() == ' ')
+        {
+            definesLine.pop_back();
+        }
+
+        id += " (" + definesLine + ')';
+    }
+
+    auto& shader = variants_[defines];
+    shader = std::make_unique<Shader>(std::initializer_list<std::string_view>{source_}, id, defines);
+    return *shader;
 }
 
 } // namespace hppv
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include <glm/vec2.hpp>
 
@@ -14,12 +15,39 @@ namespace hppv
 class Texture
 {
 public:
-    explicit Texture(const std::string& filename);
-    Texture(GLenum format, glm::ivec2 size);
+    // GL_TEXTURE_2D_ARRAY, see Render::TexArray
+    struct Array {};
+
+    // mipmaps - allocate the full mip chain (use with Sample::Trilinear),
+    // for the loaded images it is generated on the GPU
+
+    // *.hptx files (see TextureFile.hpp) have the mipmaps precomputed,
+    // the mipmaps argument is ignored
+    explicit Texture(const std::string& filename, bool mipmaps = false);
+
+    // call generateMipmaps() after the level 0 is updated
+    Texture(GLenum format, glm::ivec2 size, bool mipmaps = false);
+
     Texture();
 
+    // all images must have the same size (of the first image),
+    // layers that failed to load are filled with green
+    Texture(Array, const std::vector<std::string>& filenames, bool mipmaps = false);
+
+    Texture(Array, GLenum format, glm::ivec2 size, int numLayers, bool mipmaps = false);
+
+    // size of a single layer for arrays
     glm::ivec2 getSize() const {return size_;}
 
+    int getNumLevels() const {return numLevels_;}
+
+    // binds the texture
+    void generateMipmaps();
+
+    bool isArray() const {return numLayers_;}
+
+    int getNumLayers() const {return numLayers_;}
+
     void bind(GLuint unit = 0);
 
     GLuint getId() {return texture_.getId();}
@@ -27,8 +55,13 @@ public:
 private:
     GLtexture texture_;
     glm::ivec2 size_;
+    int numLayers_ = 0; // 0 - GL_TEXTURE_2D
+    int numLevels_ = 1;
 
     void createDefault();
+
+    // returns false on failure
+    bool loadHptx(const std::string& filename);
 };
 
 } // namespace hppv
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "Texture.hpp"
+
+namespace hppv
+{
+
+struct AtlasImage
+{
+    int page; // see TextureAtlas::getPage()
+    glm::ivec2 size; // in pixels
+
+    // use with Renderer::normalizeTexRect == false (default)
+    glm::vec4 texRect;
+};
+
+// packs images into one or more textures (pages) at load,
+// sprites using images from the same page can be rendered in one batch
+
+// the images that failed to load are replaced with a green pixel
+
+class TextureAtlas
+{
+public:
+    TextureAtlas() = default;
+
+    // the order of images matches the order of filenames
+    explicit TextureAtlas(const std::vector<std::string>& filenames, glm::ivec2 pageSize = {2048, 2048});
+
+    const AtlasImage& getImage(int id) const {return images_[id];}
+
+    int getNumImages() const {return images_.size();}
+
+    Texture& getPage(int page) {return pages_[page];}
+
+    // convenience
+    Texture& getPage(const AtlasImage& image) {return pages_[image.page];}
+
+    int getNumPages() const {return pages_.size();}
+
+private:
+    // border pixels are repeated in the padding, so the linear sampling does not bleed
+    enum {Padding = 1};
+
+    std::vector<Texture> pages_;
+    std::vector<AtlasImage> images_;
+};
+
+} // namespace hppv
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+// *.hptx - preprocessed texture container, see tools/texpack
+//
+// * little-endian
+// * Header, Level[numLevels], level data (4-byte aligned)
+// * rows are already flipped for OpenGL (the first row is the bottom one)
+// * all the mipmap levels are stored (numLevels == 1 - no mipmaps)
+//
+// Texture(filename) loads it with mmap() and uploads the levels directly
+
+namespace hppv
+{
+namespace hptx
+{
+
+enum class Format: std::uint32_t
+{
+    Gray8, // GL_R8, sampled as (r, r, r, 1)
+    GrayAlpha8, // GL_RG8, sampled as (r, r, r, g)
+    Rgba8,
+    Bc1, // GL_COMPRESSED_RGBA_S3TC_DXT1_EXT (opaque)
+    Bc3 // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+};
+
+enum {Version = 1};
+
+struct Header
+{
+    char magic[4]; // "HPTX"
+    std::uint32_t version;
+    Format format;
+    std::uint32_t sizeX;
+    std::uint32_t sizeY;
+    std::uint32_t numLevels;
+};
+
+struct Level
+{
+    std::uint32_t offset; // from the beginning of the file
+    std::uint32_t size; // in bytes
+};
+
+} // namespace hptx
+} // namespace hppv
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <glm/vec2.hpp>
+
+#include "Texture.hpp"
+#include "GLobjects.hpp"
+
+namespace hppv
+{
+
+// images are decoded by the worker threads and uploaded (GL_RGBA8) through
+// pixel buffer objects in update(), at most bytesPerFrame per call
+
+// a texture keeps its current content (e.g. the default green pixel) until its upload
+// is complete, see load()
+
+class TextureLoader
+{
+public:
+    // numThreads == 0 - std::thread::hardware_concurrency()
+    explicit TextureLoader(int numThreads = 0, int bytesPerFrame = 8 * 1024 * 1024);
+
+    ~TextureLoader();
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // mipmaps are generated on the GPU after the last row is uploaded,
+    // the texture must not be moved or destroyed until the upload is complete
+    // (getNumPending() == 0), there is no way to cancel a load
+    void load(Texture& texture, const std::string& filename, bool mipmaps = false);
+
+    // call once per frame on the GL thread
+    void update();
+
+    // number of textures not yet uploaded
+    int getNumPending() const {return numPending_;}
+
+    bool isDone() const {return numPending_ == 0;}
+
+private:
+    enum {NumPbos = 2};
+
+    struct Job
+    {
+        Texture* texture;
+        std::string filename;
+        bool mipmaps;
+    };
+
+    struct Image
+    {
+        Texture* texture;
+        unsigned char* data; // nullptr on failure
+        glm::ivec2 size;
+        bool mipmaps;
+    };
+
+    struct Upload
+    {
+        Image image;
+        Texture staging;
+        int row;
+    };
+
+    const int bytesPerFrame_;
+    int numPending_ = 0;
+
+    // shared with the worker threads
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<Job> jobs_;
+    std::deque<Image> images_;
+    bool quit_ = false;
+
+    std::vector<std::thread> threads_;
+
+    // GL thread only
+    std::optional<Upload> upload_;
+    GLbo pbos_[NumPbos];
+    int pboIndex_ = 0;
+
+    void work();
+};
+
+} // namespace hppv
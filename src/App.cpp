@@ -7,6 +7,7 @@
 
 #include <hppv/App.hpp>
 #include <hppv/Renderer.hpp>
+#include <hppv/Shader.hpp>
 #include <hppv/Space.hpp>
 #include <hppv/imgui.h>
 
@@ -20,6 +21,7 @@ Frame App::frame_;
 bool App::handleQuitEvent_;
 std::vector<Request> App::requests_;
 std::vector<Event> App::events_;
+std::unique_ptr<Jobs> App::jobs_;
 
 bool App::initialize(const InitParams& initParams)
 {
@@ -49,6 +51,14 @@ bool App::initialize(const InitParams& initParams)
         glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE);
     }
 
+    const auto& capture = initParams.capture;
+    const auto headless = capture.filename.size() && capture.headless;
+
+    if(headless)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
+
     window_ = glfwCreateWindow(initParams.window.size.x, initParams.window.size.y, initParams.window.title.c_str(),
                                nullptr, nullptr);
 
@@ -82,7 +92,21 @@ bool App::initialize(const InitParams& initParams)
         return false;
     }
 
-    glfwSwapInterval(1);
+    glfwSwapInterval(!headless);
+
+    if(capture.filename.size())
+    {
+        capture_ = std::make_unique<Capture>(capture.format, capture.filename, capture.fps);
+        captureNumFrames_ = capture.numFrames;
+        captureFrameTime_ = 1.f / capture.fps;
+    }
+
+    if(headless)
+    {
+        headlessFramebuffer_ = std::make_unique<Framebuffer>(GL_RGBA8, 1, 0, true);
+        Framebuffer::setDefault(headlessFramebuffer_.get());
+        deleterDefaultFramebuffer_.set([]{Framebuffer::setDefault(nullptr);});
+    }
 
     ImGui_ImplGlfwGL3_Init(window_, false);
     deleterImgui_.set([]{ImGui_ImplGlfwGL3_Shutdown();});
@@ -102,6 +126,9 @@ bool App::initialize(const InitParams& initParams)
 
     handleQuitEvent_ = initParams.handleQuitEvent;
 
+    Shader::setBinaryCacheDir(initParams.shaderBinaryCacheDir);
+    Shader::setDeferredCompilation(initParams.deferShaderCompilation);
+
     frame_.window.restored.pos = {0, 0};
     frame_.window.restored.size = initParams.window.size;
 
@@ -125,6 +152,8 @@ void App::run()
     std::vector<Scene*> scenesToRender;
     scenesToRender.reserve(ReservedScenes);
 
+    waitForShaders();
+
     auto time = glfwGetTime();
 
     while(scenes_.size())
@@ -158,7 +187,7 @@ void App::run()
 
         {
             const auto newTime = glfwGetTime();
-            frame_.time = newTime - time;
+            frame_.time = capture_ ? captureFrameTime_ : newTime - time;
             time = newTime;
         }
 
@@ -187,6 +216,8 @@ void App::run()
             }
         }
 
+        waitForJobs();
+
         scenesToRender.clear();
 
         for(auto it = scenes_.crbegin(); it != scenes_.crend(); ++it)
@@ -197,7 +228,14 @@ void App::run()
                 break;
         }
 
-        glClear(GL_COLOR_BUFFER_BIT);
+        if(headlessFramebuffer_)
+        {
+            headlessFramebuffer_->bind();
+            headlessFramebuffer_->setSize(frame_.framebufferSize);
+        }
+
+        // the stencil buffer for Renderer::stencilWrite()
+        glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
         for(auto scene: scenesToRender)
         {
@@ -208,8 +246,28 @@ void App::run()
 
         ImGui::Render();
 
+        if(capture_)
+        {
+            if(headlessFramebuffer_)
+            {
+                capture_->captureFrame(*headlessFramebuffer_);
+            }
+            else
+            {
+                capture_->captureFrame(frame_.framebufferSize);
+            }
+
+            if(capture_->getNumFrames() == captureNumFrames_)
+            {
+                glfwSetWindowShouldClose(window_, GLFW_TRUE);
+            }
+        }
+
         glfwSwapBuffers(window_);
 
+        // the jobs scheduled in render() might use the scenes that are about to be popped
+        waitForJobs();
+
         auto& topScene = *scenes_.back();
         auto sceneToPush = std::move(topScene.properties_.sceneToPush);
 
@@ -224,6 +282,9 @@ void App::run()
             scenes_.push_back(std::move(sceneToPush));
         }
     }
+
+    // writes the remaining frames while the context is still alive
+    capture_.reset();
 }
 
 glm::vec2 App::getCursorPos()
@@ -260,6 +321,52 @@ void App::refreshFrame()
     }
 }
 
+Jobs& App::getJobs()
+{
+    if(!jobs_)
+    {
+        jobs_ = std::make_unique<Jobs>();
+    }
+
+    return *jobs_;
+}
+
+void App::waitForJobs()
+{
+    if(jobs_)
+    {
+        jobs_->waitAll();
+    }
+}
+
+// the scenes and the renderer are constructed at this point
+void App::waitForShaders()
+{
+    while(Shader::getNumCompiling() && !glfwWindowShouldClose(window_))
+    {
+        glfwPollEvents();
+        ImGui_ImplGlfwGL3_NewFrame();
+        refreshFrame();
+
+        {
+            const glm::vec2 size = frame_.framebufferSize;
+            ImGui::SetNextWindowPos({size.x / 2.f, size.y / 2.f}, ImGuiCond_Always, {0.5f, 0.5f});
+        }
+
+        ImGui::Begin("loading", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize |
+                                         ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoMove);
+        {
+            ImGui::Text("compiling shaders (%d left)", Shader::getNumCompiling());
+        }
+        ImGui::End();
+
+        glViewport(0, 0, frame_.framebufferSize.x, frame_.framebufferSize.y);
+        glClear(GL_COLOR_BUFFER_BIT);
+        ImGui::Render();
+        glfwSwapBuffers(window_);
+    }
+}
+
 void App::setFullscreen()
 {
     auto* const monitor = glfwGetPrimaryMonitor();
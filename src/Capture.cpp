@@ -0,0 +1,595 @@
+#include <iostream>
+#include <cassert>
+#include <cstdint>
+#include <cstdio> // std::snprintf
+#include <cstdlib> // std::abs
+#include <cstring> // std::memcpy
+#include <algorithm> // std::max, std::min
+
+#include <glm/common.hpp> // glm::clamp
+
+#include <hppv/Capture.hpp>
+
+namespace hppv
+{
+
+// -----
+// PNG encoder, the compression is LZ77 with the fixed Huffman codes
+// (RFC 1950, 1951), similar to stb_image_write
+
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<unsigned char>& out): out_(out) {}
+
+    // LSB first
+    void write(const std::uint32_t bits, const int count)
+    {
+        buffer_ |= bits << numBits_;
+        numBits_ += count;
+
+        while(numBits_ >= 8)
+        {
+            out_.push_back(buffer_ & 255);
+            buffer_ >>= 8;
+            numBits_ -= 8;
+        }
+    }
+
+    // Huffman codes are stored MSB first
+    void writeCode(std::uint32_t code, const int count)
+    {
+        std::uint32_t reversed = 0;
+
+        for(auto i = 0; i < count; ++i)
+        {
+            reversed = (reversed << 1) | (code & 1);
+            code >>= 1;
+        }
+
+        write(reversed, count);
+    }
+
+    void flush()
+    {
+        if(numBits_)
+        {
+            write(0, 8 - numBits_);
+        }
+    }
+
+private:
+    std::vector<unsigned char>& out_;
+    std::uint32_t buffer_ = 0;
+    int numBits_ = 0;
+};
+
+void writeLiteral(BitWriter& writer, const int symbol)
+{
+    if(symbol <= 143)
+        writer.writeCode(0x30 + symbol, 8);
+    else if(symbol <= 255)
+        writer.writeCode(0x190 + symbol - 144, 9);
+    else if(symbol <= 279)
+        writer.writeCode(symbol - 256, 7);
+    else
+        writer.writeCode(0xc0 + symbol - 280, 8);
+}
+
+void writeMatch(BitWriter& writer, const int length, const int distance)
+{
+    static const int lengthBase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67,
+                                     83, 99, 115, 131, 163, 195, 227, 258};
+
+    static const int lengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5,
+                                      5, 5, 0};
+
+    static const int distanceBase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513,
+                                       769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+
+    static const int distanceExtra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10,
+                                        11, 11, 12, 12, 13, 13};
+
+    auto l = 28;
+
+    while(lengthBase[l] > length)
+        --l;
+
+    writeLiteral(writer, 257 + l);
+    writer.write(length - lengthBase[l], lengthExtra[l]);
+
+    auto d = 29;
+
+    while(distanceBase[d] > distance)
+        --d;
+
+    writer.writeCode(d, 5);
+    writer.write(distance - distanceBase[d], distanceExtra[d]);
+}
+
+std::vector<unsigned char> zlibCompress(const std::vector<unsigned char>& data)
+{
+    enum
+    {
+        WindowSize = 32768,
+        MinMatch = 3,
+        MaxMatch = 258,
+        HashBits = 15,
+        MaxChain = 8
+    };
+
+    std::vector<unsigned char> out;
+    out.reserve(data.size() / 2);
+    out.push_back(0x78); // deflate, 32K window
+    out.push_back(0x01);
+
+    BitWriter writer(out);
+    writer.write(1, 1); // the last block
+    writer.write(1, 2); // fixed Huffman codes
+
+    // head[hash] - the most recent position, prev[pos % WindowSize] - the previous one with the same hash
+    std::vector<int> head(1 << HashBits, -1);
+    std::vector<int> prev(WindowSize, -1);
+
+    const int size = data.size();
+
+    auto hash = [&data](const int pos)
+    {
+        const std::uint32_t v = data[pos] | data[pos + 1] << 8 | data[pos + 2] << 16;
+        return (v * 2654435761u) >> (32 - HashBits);
+    };
+
+    auto insert = [&](const int pos)
+    {
+        const auto h = hash(pos);
+        prev[pos % WindowSize] = head[h];
+        head[h] = pos;
+    };
+
+    auto pos = 0;
+
+    while(pos < size)
+    {
+        auto bestLength = 0, bestDistance = 0;
+
+        if(pos + MinMatch <= size)
+        {
+            const auto maxLength = std::min<int>(MaxMatch, size - pos);
+            auto candidate = head[hash(pos)];
+
+            for(auto chain = 0; chain < MaxChain && candidate >= 0 && pos - candidate <= WindowSize; ++chain)
+            {
+                auto length = 0;
+
+                while(length < maxLength && data[candidate + length] == data[pos + length])
+                    ++length;
+
+                if(length > bestLength)
+                {
+                    bestLength = length;
+                    bestDistance = pos - candidate;
+
+                    if(length == maxLength)
+                        break;
+                }
+
+                candidate = prev[candidate % WindowSize];
+            }
+        }
+
+        if(bestLength >= MinMatch)
+        {
+            writeMatch(writer, bestLength, bestDistance);
+
+            for(const auto end = pos + bestLength; pos < end; ++pos)
+            {
+                if(pos + MinMatch <= size)
+                    insert(pos);
+            }
+        }
+        else
+        {
+            writeLiteral(writer, data[pos]);
+
+            if(pos + MinMatch <= size)
+                insert(pos);
+
+            ++pos;
+        }
+    }
+
+    writeLiteral(writer, 256);
+    writer.flush();
+
+    std::uint32_t a = 1, b = 0;
+
+    for(const auto byte: data)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+
+    const auto adler = b << 16 | a;
+
+    for(auto i = 3; i >= 0; --i)
+        out.push_back((adler >> (i * 8)) & 255);
+
+    return out;
+}
+
+std::uint32_t crc32(const unsigned char* const data, const std::size_t size, std::uint32_t crc = 0)
+{
+    static const auto table = []
+    {
+        std::vector<std::uint32_t> table(256);
+
+        for(std::uint32_t i = 0; i < 256; ++i)
+        {
+            auto c = i;
+
+            for(auto k = 0; k < 8; ++k)
+                c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+
+            table[i] = c;
+        }
+
+        return table;
+    }();
+
+    crc = ~crc;
+
+    for(std::size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 255] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+void writeBigEndian(std::ofstream& file, const std::uint32_t value)
+{
+    const char bytes[] = {char(value >> 24), char(value >> 16), char(value >> 8), char(value)};
+    file.write(bytes, 4);
+}
+
+void writeChunk(std::ofstream& file, const char* const type, const std::vector<unsigned char>& data)
+{
+    writeBigEndian(file, data.size());
+    file.write(type, 4);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+    auto crc = crc32(reinterpret_cast<const unsigned char*>(type), 4);
+    crc = crc32(data.data(), data.size(), crc);
+    writeBigEndian(file, crc);
+}
+
+int paeth(const int a, const int b, const int c)
+{
+    const auto p = a + b - c;
+    const auto pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+
+    if(pa <= pb && pa <= pc)
+        return a;
+
+    return pb <= pc ? b : c;
+}
+
+// rgba, bottom-up -> rgb png
+bool writePng(const std::string& filename, const unsigned char* const pixels, const glm::ivec2 size)
+{
+    const auto rowBytes = size.x * 3;
+    std::vector<unsigned char> filtered;
+    filtered.reserve((rowBytes + 1) * size.y);
+
+    std::vector<unsigned char> row(rowBytes), prevRow(rowBytes, 0), candidate(rowBytes), best(rowBytes);
+
+    for(auto y = 0; y < size.y; ++y)
+    {
+        const auto* const src = pixels + (size.y - 1 - y) * size.x * 4;
+
+        for(auto x = 0; x < size.x; ++x)
+        {
+            row[x * 3 + 0] = src[x * 4 + 0];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + 2];
+        }
+
+        // the filter with the minimum sum of absolute differences
+        auto bestFilter = 0;
+        auto bestSum = -1;
+
+        for(auto filter = 0; filter < 5; ++filter)
+        {
+            auto sum = 0;
+
+            for(auto i = 0; i < rowBytes; ++i)
+            {
+                const int a = i >= 3 ? row[i - 3] : 0;
+                const int b = prevRow[i];
+                const int c = i >= 3 ? prevRow[i - 3] : 0;
+                int predicted = 0;
+
+                switch(filter)
+                {
+                case 1: predicted = a; break;
+                case 2: predicted = b; break;
+                case 3: predicted = (a + b) / 2; break;
+                case 4: predicted = paeth(a, b, c); break;
+                }
+
+                candidate[i] = row[i] - predicted;
+                sum += std::abs(static_cast<signed char>(candidate[i]));
+            }
+
+            if(bestSum == -1 || sum < bestSum)
+            {
+                bestSum = sum;
+                bestFilter = filter;
+                best.swap(candidate);
+            }
+        }
+
+        filtered.push_back(bestFilter);
+        filtered.insert(filtered.end(), best.begin(), best.end());
+        prevRow.swap(row);
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+
+    if(!file)
+        return false;
+
+    const unsigned char signature[] = {137, 80, 78, 71, 13, 10, 26, 10};
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    {
+        std::vector<unsigned char> header(13, 0);
+
+        for(auto i = 0; i < 4; ++i)
+        {
+            header[i] = (size.x >> (24 - i * 8)) & 255;
+            header[4 + i] = (size.y >> (24 - i * 8)) & 255;
+        }
+
+        header[8] = 8; // bit depth
+        header[9] = 2; // rgb
+        writeChunk(file, "IHDR", header);
+    }
+
+    writeChunk(file, "IDAT", zlibCompress(filtered));
+    writeChunk(file, "IEND", {});
+
+    return bool(file);
+}
+
+// -----
+
+Capture::Capture(const Format format, const std::string& filename, const int fps, int numThreads):
+    format_(format),
+    filename_(filename),
+    fps_(fps)
+{
+    if(format == Y4m)
+    {
+        file_.open(filename, std::ios::binary);
+
+        if(!file_)
+        {
+            std::cout << "Capture: could not open the file, filename = " << filename << std::endl;
+        }
+    }
+
+    if(numThreads == 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    maxJobs_ = numThreads * 2;
+
+    for(auto i = 0; i < numThreads; ++i)
+    {
+        threads_.emplace_back(&Capture::work, this);
+    }
+}
+
+Capture::~Capture()
+{
+    for(auto i = 0; i < NumReadbacks; ++i)
+    {
+        const auto index = (readbackIndex_ + i) % NumReadbacks;
+
+        if(readbacks_[index].isPending())
+        {
+            collect(index);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+
+    condition_.notify_all();
+
+    for(auto& thread: threads_)
+    {
+        thread.join();
+    }
+}
+
+void Capture::captureFrame(const glm::ivec2 size)
+{
+    Framebuffer::readDefaultAsync(getNextReadback(), size);
+}
+
+void Capture::captureFrame(Framebuffer& framebuffer)
+{
+    framebuffer.readAsync(getNextReadback());
+}
+
+Readback& Capture::getNextReadback()
+{
+    const auto index = readbackIndex_;
+
+    // the oldest transfer, issued NumReadbacks frames ago
+    if(readbacks_[index].isPending())
+    {
+        collect(index);
+    }
+
+    readbackFrames_[index] = numFrames_;
+    readbackIndex_ = (index + 1) % NumReadbacks;
+    ++numFrames_;
+    return readbacks_[index];
+}
+
+void Capture::collect(const int readbackIndex)
+{
+    auto& readback = readbacks_[readbackIndex];
+
+    Job job;
+    job.frame = readbackFrames_[readbackIndex];
+    job.size = readback.getSize();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        conditionSpace_.wait(lock, [this]{return int(jobs_.size()) < maxJobs_;});
+
+        if(freeBuffers_.size())
+        {
+            job.pixels = std::move(freeBuffers_.back());
+            freeBuffers_.pop_back();
+        }
+    }
+
+    const auto numBytes = job.size.x * job.size.y * 4;
+    job.pixels.resize(numBytes);
+    std::memcpy(job.pixels.data(), readback.getPixels(), numBytes);
+    readback.unmap();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(std::move(job));
+    }
+
+    condition_.notify_one();
+}
+
+void Capture::work()
+{
+    for(;;)
+    {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]{return quit_ || jobs_.size();});
+
+            // the remaining jobs are finished before quitting
+            if(jobs_.empty())
+                return;
+
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        conditionSpace_.notify_one();
+
+        if(format_ == Png)
+        {
+            char number[16];
+            std::snprintf(number, sizeof(number), "%06d", job.frame);
+            const auto filename = filename_ + number + ".png";
+
+            if(!writePng(filename, job.pixels.data(), job.size))
+            {
+                std::cout << "Capture: could not write the frame, filename = " << filename << std::endl;
+            }
+        }
+        else
+        {
+            // 4:2:0, the chroma planes are the averages of the 2x2 blocks
+            const auto size = job.size;
+            const glm::ivec2 chromaSize = (size + 1) / 2;
+            std::vector<unsigned char> yuv(size.x * size.y + chromaSize.x * chromaSize.y * 2);
+            auto* const planeY = yuv.data();
+            auto* const planeCb = planeY + size.x * size.y;
+            auto* const planeCr = planeCb + chromaSize.x * chromaSize.y;
+
+            for(auto y = 0; y < size.y; ++y)
+            {
+                const auto* const src = job.pixels.data() + (size.y - 1 - y) * size.x * 4;
+
+                for(auto x = 0; x < size.x; ++x)
+                {
+                    const float r = src[x * 4], g = src[x * 4 + 1], b = src[x * 4 + 2];
+                    planeY[y * size.x + x] = 0.299f * r + 0.587f * g + 0.114f * b + 0.5f;
+                }
+            }
+
+            for(auto y = 0; y < chromaSize.y; ++y)
+            {
+                for(auto x = 0; x < chromaSize.x; ++x)
+                {
+                    float r = 0.f, g = 0.f, b = 0.f;
+                    auto count = 0;
+
+                    for(auto sy = y * 2; sy < std::min(y * 2 + 2, size.y); ++sy)
+                    {
+                        for(auto sx = x * 2; sx < std::min(x * 2 + 2, size.x); ++sx)
+                        {
+                            const auto* const p = job.pixels.data() + ((size.y - 1 - sy) * size.x + sx) * 4;
+                            r += p[0];
+                            g += p[1];
+                            b += p[2];
+                            ++count;
+                        }
+                    }
+
+                    r /= count;
+                    g /= count;
+                    b /= count;
+
+                    const auto i = y * chromaSize.x + x;
+                    planeCb[i] = glm::clamp(128.f - 0.168736f * r - 0.331264f * g + 0.5f * b + 0.5f, 0.f, 255.f);
+                    planeCr[i] = glm::clamp(128.f + 0.5f * r - 0.418688f * g - 0.081312f * b + 0.5f, 0.f, 255.f);
+                }
+            }
+
+            writeY4m(job.frame, size, std::move(yuv));
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        freeBuffers_.push_back(std::move(job.pixels));
+    }
+}
+
+void Capture::writeY4m(const int frame, const glm::ivec2 size, std::vector<unsigned char>&& yuv)
+{
+    std::lock_guard<std::mutex> lock(mutexFile_);
+
+    encodedFrames_.emplace(frame, EncodedFrame{size, std::move(yuv)});
+
+    // the frames are written in order
+    for(auto it = encodedFrames_.begin(); it != encodedFrames_.end() && it->first == nextFrameToWrite_;
+        it = encodedFrames_.erase(it))
+    {
+        ++nextFrameToWrite_;
+        const auto& encoded = it->second;
+
+        if(fileSize_ == glm::ivec2(0))
+        {
+            fileSize_ = encoded.size;
+            file_ << "YUV4MPEG2 W" << fileSize_.x << " H" << fileSize_.y << " F" << fps_ << ":1 Ip A1:1 C420jpeg\n";
+        }
+
+        if(encoded.size != fileSize_)
+        {
+            std::cout << "Capture: the framebuffer size has changed, skipping frame " << it->first << std::endl;
+            continue;
+        }
+
+        file_ << "FRAME\n";
+        file_.write(reinterpret_cast<const char*>(encoded.yuv.data()), encoded.yuv.size());
+    }
+}
+
+} // namespace hppv
@@ -3,10 +3,14 @@
 #include <vector>
 #include <set>
 #include <experimental/filesystem> // std::experimental::filesystem::path
-#include <algorithm> // std::max
+#include <algorithm> // std::max, std::clamp, std::copy
 #include <cstdlib> // std::atoi
+#include <cmath> // std::sqrt
+
+#include <glm/common.hpp> // glm::floor, glm::ceil
 
 #include <hppv/Font.hpp>
+#include <hppv/App.hpp>
 #include <hppv/glad.h>
 
 // imgui needs it
@@ -36,6 +40,31 @@ void printFileOpenError(const std::string& filename)
     std::cout << "Font: could not open file = " << filename << std::endl;
 }
 
+bool isTrueType(const std::string& filename)
+{
+    return filename.find(".ttf") != std::string::npos ||
+           filename.find(".otf") != std::string::npos;
+}
+
+// returns an empty vector on failure
+std::vector<unsigned char> loadTtfData(const std::string& filename)
+{
+    std::ifstream file(filename, file.binary | file.ate);
+
+    if(!file)
+    {
+        printFileOpenError(filename);
+        return {};
+    }
+
+    std::vector<unsigned char> ttfData;
+    const auto size = file.tellg();
+    ttfData.resize(size);
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(ttfData.data()), size);
+    return ttfData;
+}
+
 Font::Font(const std::string& filename, const int sizePx, const std::string_view additionalChars)
 {
     // replace find with regex (*.ext)?
@@ -44,28 +73,31 @@ Font::Font(const std::string& filename, const int sizePx, const std::string_view
     {
         loadFnt(filename);
     }
-    else if(filename.find(".ttf") != std::string::npos ||
-            filename.find(".otf") != std::string::npos)
+    else if(isTrueType(filename))
     {
-        std::ifstream file(filename, file.binary | file.ate);
-
-        if(!file)
+        if(const auto ttfData = loadTtfData(filename); ttfData.size())
         {
-            printFileOpenError(filename);
+            loadTrueType(ttfData.data(), sizePx, additionalChars, filename, false);
         }
-        else
+    }
+    else
+    {
+        std::cout << "Font: unsupported file format - " << filename << std::endl;
+    }
+}
+
+Font::Font(Sdf, const std::string& filename, const int sizePx, const std::string_view additionalChars)
+{
+    if(isTrueType(filename))
+    {
+        if(const auto ttfData = loadTtfData(filename); ttfData.size())
         {
-            std::vector<unsigned char> ttfData;
-            const auto size = file.tellg();
-            ttfData.resize(size);
-            file.seekg(0);
-            file.read(reinterpret_cast<char*>(ttfData.data()), size);
-            loadTrueType(ttfData.data(), sizePx, additionalChars, filename);
+            loadTrueType(ttfData.data(), sizePx, additionalChars, filename, true);
         }
     }
     else
     {
-        std::cout << "Font: unsupported file format - " << filename << std::endl;
+        std::cout << "Font: unsupported file format for sdf generation - " << filename << std::endl;
     }
 }
 
@@ -77,7 +109,7 @@ Font::Font(Default, const int sizePx, const std::string_view additionalChars)
     Decode85(reinterpret_cast<const unsigned char*>(compressedTtfDataBase85), compressedTtfData.data());
     std::vector<unsigned char> decompressedTtfData(stb_decompress_length(compressedTtfData.data()));
     stb_decompress(decompressedTtfData.data(), compressedTtfData.data(), compressedTtfData.size());
-    loadTrueType(decompressedTtfData.data(), sizePx, additionalChars, "ProggyClean.ttf (embedded)");
+    loadTrueType(decompressedTtfData.data(), sizePx, additionalChars, "ProggyClean.ttf (embedded)", false);
 }
 
 Glyph Font::getGlyph(const int code) const
@@ -91,6 +123,66 @@ Glyph Font::getGlyph(const int code) const
     return {};
 }
 
+std::uint64_t kerningKey(const int first, const int second)
+{
+    return (static_cast<std::uint64_t>(first) << 32) | static_cast<std::uint32_t>(second);
+}
+
+std::size_t kerningHash(const std::uint64_t key)
+{
+    // Fibonacci hashing
+    return (key * 11400714819323198485ull) >> 32;
+}
+
+int Font::getKerning(const int first, const int second) const
+{
+    if(kerning_.empty())
+        return 0;
+
+    const auto key = kerningKey(first, second);
+    const auto mask = kerning_.size() - 1;
+
+    for(auto i = kerningHash(key) & mask;; i = (i + 1) & mask)
+    {
+        if(kerning_[i].key == key)
+            return kerning_[i].amount;
+
+        if(kerning_[i].key == 0)
+            return 0;
+    }
+}
+
+void Font::setKerning(const std::vector<KerningPair>& pairs)
+{
+    kerning_.clear();
+
+    if(pairs.empty())
+        return;
+
+    // load factor <= 0.5
+    std::size_t size = 1;
+
+    while(size < pairs.size() * 2)
+    {
+        size *= 2;
+    }
+
+    kerning_.resize(size, {0, 0});
+    const auto mask = size - 1;
+
+    for(const auto& pair: pairs)
+    {
+        auto i = kerningHash(pair.key) & mask;
+
+        while(kerning_[i].key && kerning_[i].key != pair.key)
+        {
+            i = (i + 1) & mask;
+        }
+
+        kerning_[i] = pair;
+    }
+}
+
 struct Value
 {
     int value;
@@ -162,10 +254,159 @@ void Font::loadFnt(const std::string& filename)
         value = getValue(line, value.posNext);
         glyph.advance = value.value;
     }
+
+    std::getline(file, line);
+
+    if(line.find("kernings") != 0)
+        return;
+
+    const auto numKernings = getValue(line, 0).value;
+    std::vector<KerningPair> pairs;
+    pairs.reserve(numKernings);
+
+    for(auto i = 0; i < numKernings; ++i)
+    {
+        std::getline(file, line);
+
+        const auto first = getValue(line, 0);
+        const auto second = getValue(line, first.posNext);
+        const auto amount = getValue(line, second.posNext);
+
+        if(amount.value)
+        {
+            pairs.push_back({kerningKey(first.value, second.value), amount.value});
+        }
+    }
+
+    setKerning(pairs);
+}
+
+// cs.cornell.edu/~dph/papers/dt.pdf
+
+enum {EdtInf = 1000000000};
+
+// squared distance transform of a sampled function (1D)
+// v and z must have a space for n and n + 1 elements
+void edt(const float* const f, float* const d, int* const v, float* const z, const int n)
+{
+    auto k = 0;
+    v[0] = 0;
+    z[0] = -EdtInf;
+    z[1] = EdtInf;
+
+    for(auto q = 1; q < n; ++q)
+    {
+        float s;
+
+        for(;;)
+        {
+            s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+
+            if(s > z[k])
+                break;
+
+            --k;
+        }
+
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = EdtInf;
+    }
+
+    k = 0;
+
+    for(auto q = 0; q < n; ++q)
+    {
+        while(z[k + 1] < q)
+        {
+            ++k;
+        }
+
+        d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+    }
+}
+
+// grid: 0 - feature pixel, EdtInf - other pixel
+// on return grid holds squared distances to the nearest feature pixel
+void edt(std::vector<float>& grid, const glm::ivec2 size)
+{
+    const auto n = std::max(size.x, size.y);
+    std::vector<float> f(n), d(n), z(n + 1);
+    std::vector<int> v(n);
+
+    for(auto i = 0; i < size.x; ++i)
+    {
+        for(auto j = 0; j < size.y; ++j)
+        {
+            f[j] = grid[j * size.x + i];
+        }
+
+        edt(f.data(), d.data(), v.data(), z.data(), size.y);
+
+        for(auto j = 0; j < size.y; ++j)
+        {
+            grid[j * size.x + i] = d[j];
+        }
+    }
+
+    for(auto j = 0; j < size.y; ++j)
+    {
+        auto* const row = grid.data() + j * size.x;
+        edt(row, d.data(), v.data(), z.data(), size.x);
+        std::copy(d.begin(), d.begin() + size.x, row);
+    }
+}
+
+// bitmap is rasterized upscale times larger than the output,
+// bitmapOffset is in the bitmap pixels, start and size are in the output pixels
+std::vector<unsigned char> createSdf(const unsigned char* const bitmap, const glm::ivec2 bitmapSize,
+                                     const glm::ivec2 bitmapOffset, const glm::ivec2 start, const glm::ivec2 size,
+                                     const int upscale, const int spread)
+{
+    const auto gridSize = size * upscale;
+    const auto bitmapPos = bitmapOffset - start * upscale;
+
+    std::vector<float> toInside(gridSize.x * gridSize.y, EdtInf);
+    std::vector<float> toOutside(gridSize.x * gridSize.y, 0.f);
+
+    for(auto j = 0; j < bitmapSize.y; ++j)
+    {
+        for(auto i = 0; i < bitmapSize.x; ++i)
+        {
+            if(bitmap[j * bitmapSize.x + i] < 128)
+                continue;
+
+            const auto idx = (bitmapPos.y + j) * gridSize.x + bitmapPos.x + i;
+            toInside[idx] = 0.f;
+            toOutside[idx] = EdtInf;
+        }
+    }
+
+    edt(toInside, gridSize);
+    edt(toOutside, gridSize);
+
+    std::vector<unsigned char> sdf(size.x * size.y);
+
+    for(auto j = 0; j < size.y; ++j)
+    {
+        for(auto i = 0; i < size.x; ++i)
+        {
+            const auto idx = (j * upscale + upscale / 2) * gridSize.x + i * upscale + upscale / 2;
+
+            // > 0 outside the glyph
+            const auto distance = (std::sqrt(toInside[idx]) - std::sqrt(toOutside[idx])) / upscale;
+
+            const auto value = std::clamp(0.5f - distance / (2.f * spread), 0.f, 1.f);
+            sdf[j * size.x + i] = value * 255.f + 0.5f;
+        }
+    }
+
+    return sdf;
 }
 
 void Font::loadTrueType(const unsigned char* const ttfData, const int sizePx, const std::string_view additionalChars,
-                        const std::string_view id)
+                        const std::string_view id, const bool sdf)
 {
     stbtt_fontinfo fontInfo;
 
@@ -205,7 +446,23 @@ void Font::loadTrueType(const unsigned char* const ttfData, const int sizePx, co
         codePoints.insert(c);
     }
 
-    std::map<int, unsigned char*> bitmaps;
+    const auto rasterScale = sdf ? scale * SdfUpscale : scale;
+
+    struct Bitmap
+    {
+        Glyph glyph;
+        unsigned char* data;
+        glm::ivec2 size;
+        glm::ivec2 offset;
+        std::vector<unsigned char> sdf;
+    };
+
+    std::vector<Bitmap> bitmaps;
+    bitmaps.reserve(codePoints.size());
+
+    // codePoint, glyph index
+    std::vector<std::pair<int, int>> glyphIds;
+    glyphIds.reserve(codePoints.size());
     int maxBitmapSizeY = 0;
     glm::ivec2 pos(0);
 
@@ -219,17 +476,38 @@ void Font::loadTrueType(const unsigned char* const ttfData, const int sizePx, co
             continue;
         }
 
-        Glyph glyph;
+        glyphIds.push_back({codePoint, id});
+
+        bitmaps.emplace_back();
+        auto& bitmap = bitmaps.back();
+        auto& glyph = bitmap.glyph;
+
         int dummy;
         stbtt_GetGlyphHMetrics(&fontInfo, id, &glyph.advance, &dummy);
         glyph.advance *= scale;
 
-        int offsetY;
+        bitmap.data = stbtt_GetGlyphBitmap(&fontInfo, rasterScale, rasterScale, id, &bitmap.size.x, &bitmap.size.y,
+                                           &bitmap.offset.x, &bitmap.offset.y);
 
-        bitmaps[codePoint] = stbtt_GetGlyphBitmap(&fontInfo, scale, scale, id, &glyph.texRect.z, &glyph.texRect.w,
-                                                  &glyph.offset.x, &offsetY);
+        if(sdf && bitmap.size.x && bitmap.size.y)
+        {
+            const auto start = glm::ivec2(glm::floor(glm::vec2(bitmap.offset) / float(SdfUpscale))) - int(SdfSpread);
 
-        glyph.offset.y = ascent + offsetY;
+            const auto end = glm::ivec2(glm::ceil(glm::vec2(bitmap.offset + bitmap.size) / float(SdfUpscale)))
+                             + int(SdfSpread);
+
+            glyph.texRect.z = end.x - start.x;
+            glyph.texRect.w = end.y - start.y;
+            glyph.offset.x = start.x;
+            glyph.offset.y = ascent + start.y;
+        }
+        else
+        {
+            glyph.texRect.z = bitmap.size.x;
+            glyph.texRect.w = bitmap.size.y;
+            glyph.offset.x = bitmap.offset.x;
+            glyph.offset.y = ascent + bitmap.offset.y;
+        }
 
         if(pos.x + glyph.texRect.z > TexSizeX)
         {
@@ -247,10 +525,58 @@ void Font::loadTrueType(const unsigned char* const ttfData, const int sizePx, co
         maxBitmapSizeY = std::max(maxBitmapSizeY, glyph.texRect.w);
     }
 
+    if(fontInfo.kern)
+    {
+        std::vector<KerningPair> pairs;
+
+        for(const auto& first: glyphIds)
+        {
+            for(const auto& second: glyphIds)
+            {
+                const int amount = stbtt_GetGlyphKernAdvance(&fontInfo, first.second, second.second) * scale;
+
+                if(amount)
+                {
+                    pairs.push_back({kerningKey(first.first, second.first), amount});
+                }
+            }
+        }
+
+        setKerning(pairs);
+    }
+
+    if(sdf)
+    {
+        // one glyph per chunk, the sizes vary a lot
+        App::getJobs().parallelFor(bitmaps.size(), [&bitmaps, ascent](const int first, const int last)
+        {
+            for(auto i = first; i < last; ++i)
+            {
+                auto& bitmap = bitmaps[i];
+                const auto texRect = bitmap.glyph.texRect;
+
+                if(texRect.z == 0 || texRect.w == 0)
+                    continue;
+
+                const glm::ivec2 start(bitmap.glyph.offset.x, bitmap.glyph.offset.y - ascent);
+
+                bitmap.sdf = createSdf(bitmap.data, bitmap.size, bitmap.offset, start, {texRect.z, texRect.w},
+                                       SdfUpscale, SdfSpread);
+            }
+        },
+        1);
+    }
+
     texture_ = Texture(GL_R8, {TexSizeX, pos.y + maxBitmapSizeY});
     texture_.bind();
     const auto texSize = texture_.getSize();
 
+    if(sdf)
+    {
+        // Render::Sdf* shaders read the distance from the alpha channel
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_RED);
+    }
+
     std::vector<unsigned char> vec(texSize.x * texSize.y, 0);
 
     GLint unpackAlignment;
@@ -260,17 +586,17 @@ void Font::loadTrueType(const unsigned char* const ttfData, const int sizePx, co
     // clear the texture color
     glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texSize.x, texSize.y, GL_RED, GL_BYTE, vec.data());
 
-    for(const auto& glyph: glyphs_)
+    for(const auto& bitmap: bitmaps)
     {
-        auto texRect = glyph.second.texRect;
-        const auto* const bitmap = bitmaps.at(glyph.first);
+        auto texRect = bitmap.glyph.texRect;
+        const auto* const data = sdf ? bitmap.sdf.data() : bitmap.data;
 
         // flip the bitmap vertically, so it plays nice with the Renderer framework
         for(auto j = 0; j < texRect.w; ++j)
         {
             for(auto i = 0; i < texRect.z; ++i)
             {
-                vec[j * texRect.z + i] = bitmap[(texRect.w - j - 1) * texRect.z + i];
+                vec[j * texRect.z + i] = data[(texRect.w - j - 1) * texRect.z + i];
             }
         }
 
@@ -283,9 +609,9 @@ void Font::loadTrueType(const unsigned char* const ttfData, const int sizePx, co
 
     glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
 
-    for(const auto bitmap: bitmaps)
+    for(const auto& bitmap: bitmaps)
     {
-        stbtt_FreeBitmap(bitmap.second, nullptr);
+        stbtt_FreeBitmap(bitmap.data, nullptr);
     }
 }
 
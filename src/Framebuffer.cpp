@@ -1,4 +1,6 @@
 #include <cassert>
+#include <algorithm> // std::min
+#include <utility> // std::swap
 
 #include <hppv/Framebuffer.hpp>
 #include <hppv/glad.h>
@@ -6,12 +8,22 @@
 namespace hppv
 {
 
-Framebuffer::Framebuffer(const GLenum textureFormat, const int numAttachments):
+Framebuffer::Framebuffer(const GLenum textureFormat, const int numAttachments, const int samples,
+                         const bool depthStencil):
     textureFormat_(textureFormat),
-    numAttachments_(numAttachments)
+    numAttachments_(numAttachments),
+    samples_(samples),
+    depthStencil_(depthStencil)
 {
     assert(numAttachments <= MaxAttachments);
 
+    if(samples_)
+    {
+        GLint maxSamples;
+        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+        samples_ = std::min(samples_, maxSamples);
+    }
+
     bind();
 
     GLenum attachments[MaxAttachments];
@@ -33,22 +45,206 @@ void Framebuffer::bind()
 
 void Framebuffer::unbind()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer_);
+}
+
+void Framebuffer::setDefault(Framebuffer* const framebuffer)
+{
+    defaultFramebuffer_ = framebuffer ? framebuffer->framebuffer_.getId() : 0;
 }
 
 void Framebuffer::setSize(const glm::ivec2 size)
 {
+    if(hasStorage_ && size == getSize())
+    {
+        return;
+    }
+
+    hasStorage_ = true;
+
     for(auto i = 0; i < numAttachments_; ++i)
     {
         textures_[i] = Texture(textureFormat_, size);
+    }
+
+    if(depthStencil_)
+    {
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbufferDepthStencil_.getId());
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples_, GL_DEPTH24_STENCIL8, size.x, size.y);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER,
+                                  renderbufferDepthStencil_.getId());
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    }
+
+    if(samples_)
+    {
+        for(auto i = 0; i < numAttachments_; ++i)
+        {
+            glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers_[i].getId());
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples_, textureFormat_, size.x, size.y);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_RENDERBUFFER,
+                                      renderbuffers_[i].getId());
+        }
+
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebufferResolve_.getId());
+    }
+
+    for(auto i = 0; i < numAttachments_; ++i)
+    {
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D,
                                textures_[i].getId(), 0);
     }
+
+    if(samples_)
+    {
+        bind();
+    }
 }
 
 void Framebuffer::clear()
 {
-    glClear(GL_COLOR_BUFFER_BIT);
+    glClear(GL_COLOR_BUFFER_BIT | (depthStencil_ ? GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT : 0));
+}
+
+void Framebuffer::resolve()
+{
+    assert(samples_);
+
+    GLint prevReadFramebuffer, prevDrawFramebuffer;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevReadFramebuffer);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevDrawFramebuffer);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_.getId());
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebufferResolve_.getId());
+
+    const auto size = getSize();
+
+    for(auto i = 0; i < numAttachments_; ++i)
+    {
+        glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+        glDrawBuffer(GL_COLOR_ATTACHMENT0 + i);
+        glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prevDrawFramebuffer);
+}
+
+void Framebuffer::readAsync(Readback& readback, const int attachment)
+{
+    assert(attachment < numAttachments_);
+
+    const auto framebuffer = samples_ ? framebufferResolve_.getId() : framebuffer_.getId();
+    readback.request(framebuffer, GL_COLOR_ATTACHMENT0 + attachment, getSize());
+}
+
+void Framebuffer::readDefaultAsync(Readback& readback, const glm::ivec2 size)
+{
+    readback.request(0, GL_BACK, size);
+}
+
+Readback& Readback::operator=(Readback&& rhs)
+{
+    assert(this != &rhs);
+    unmap();
+
+    // the pixel buffers are swapped, so rhs can be reused
+    std::swap(pbo_, rhs.pbo_);
+    std::swap(capacity_, rhs.capacity_);
+    size_ = rhs.size_;
+    fence_ = rhs.fence_;
+    pixels_ = rhs.pixels_;
+    deleterFence_ = std::move(rhs.deleterFence_);
+
+    rhs.size_ = {0, 0};
+    rhs.fence_ = nullptr;
+    rhs.pixels_ = nullptr;
+    return *this;
+}
+
+void Readback::request(const GLuint framebuffer, const GLenum buffer, const glm::ivec2 size)
+{
+    unmap();
+    deleterFence_ = Deleter();
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo_.getId());
+
+    if(size.x * size.y > capacity_.x * capacity_.y)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size.x * size.y * 4, nullptr, GL_STREAM_READ);
+        capacity_ = size;
+    }
+
+    size_ = size;
+
+    GLint prevFramebuffer;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevFramebuffer);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(buffer);
+    glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, prevFramebuffer);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    const auto fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    fence_ = fence;
+    deleterFence_.set([fence]{glDeleteSync(fence);});
+}
+
+bool Readback::isReady()
+{
+    if(!fence_)
+    {
+        return false;
+    }
+
+    if(pixels_)
+    {
+        return true;
+    }
+
+    // flush, so the fence is guaranteed to be signaled eventually
+    const auto status = glClientWaitSync(fence_, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+const unsigned char* Readback::getPixels()
+{
+    assert(fence_);
+
+    if(!pixels_)
+    {
+        while(true)
+        {
+            const auto status = glClientWaitSync(fence_, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+
+            if(status != GL_TIMEOUT_EXPIRED)
+            {
+                break;
+            }
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo_.getId());
+
+        pixels_ = static_cast<const unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size_.x * size_.y * 4,
+                                                                     GL_MAP_READ_BIT));
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    return pixels_;
+}
+
+void Readback::unmap()
+{
+    if(pixels_)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo_.getId());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        pixels_ = nullptr;
+    }
 }
 
 } // namespace hppv
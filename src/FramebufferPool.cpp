@@ -0,0 +1,79 @@
+#include <cassert>
+#include <algorithm> // std::remove_if
+
+#include <hppv/FramebufferPool.hpp>
+#include <hppv/glad.h>
+
+namespace hppv
+{
+
+FramebufferPool::FramebufferPool(const int maxIdleFrames):
+    maxIdleFrames_(maxIdleFrames)
+{}
+
+Framebuffer& FramebufferPool::acquire(const GLenum textureFormat, const glm::ivec2 size,
+                                      const int numAttachments, const int samples, const bool depthStencil)
+{
+    for(auto& entry: entries_)
+    {
+        auto& fb = *entry.framebuffer;
+
+        if(!entry.acquired && fb.getTextureFormat() == textureFormat && fb.getSize() == size &&
+           fb.getNumAttachments() == numAttachments && entry.samples == samples &&
+           fb.hasDepthStencil() == depthStencil)
+        {
+            entry.acquired = true;
+            entry.idleFrames = 0;
+            return fb;
+        }
+    }
+
+    GLint prevFramebuffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFramebuffer);
+
+    entries_.push_back({std::make_unique<Framebuffer>(textureFormat, numAttachments, samples, depthStencil),
+                        samples, true, 0});
+    auto& fb = *entries_.back().framebuffer;
+    fb.bind();
+    fb.setSize(size);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, prevFramebuffer);
+
+    return fb;
+}
+
+void FramebufferPool::release(Framebuffer& framebuffer)
+{
+    for(auto& entry: entries_)
+    {
+        if(entry.framebuffer.get() == &framebuffer)
+        {
+            assert(entry.acquired);
+            entry.acquired = false;
+            return;
+        }
+    }
+
+    assert(false);
+}
+
+void FramebufferPool::nextFrame()
+{
+    for(auto& entry: entries_)
+    {
+        if(entry.acquired)
+        {
+            entry.acquired = false;
+        }
+        else
+        {
+            ++entry.idleFrames;
+        }
+    }
+
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                  [this](const Entry& entry){return entry.idleFrames > maxIdleFrames_;}),
+                   entries_.end());
+}
+
+} // namespace hppv
@@ -34,4 +34,10 @@ GLframebuffer::GLframebuffer():
     glGenFramebuffers(1, &id_);
 }
 
+GLrenderbuffer::GLrenderbuffer():
+    GLobject([](const GLuint id){glDeleteRenderbuffers(1, &id);})
+{
+    glGenRenderbuffers(1, &id_);
+}
+
 } // namespace hppv
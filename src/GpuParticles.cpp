@@ -0,0 +1,430 @@
+#include <cassert>
+#include <vector>
+#include <string>
+#include <algorithm> // std::min
+#include <cstddef> // offsetof
+
+#include <hppv/GpuParticles.hpp>
+#include <hppv/glad.h>
+
+namespace hppv
+{
+
+const char* const commonSource = R"(
+
+uniform float dt;
+uniform int numParticles;
+uniform int numToSpawn;
+uniform int seed;
+
+uniform vec2 spawnPos;
+uniform vec2 spawnSize;
+uniform vec2 lifeRange;
+uniform vec2 radiusRange;
+uniform vec2 velMin;
+uniform vec2 velMax;
+uniform vec4 colorStartMin;
+uniform vec4 colorStartMax;
+uniform vec4 colorEndMin;
+uniform vec4 colorEndMax;
+uniform vec4 colorPerSpeed;
+
+uniform vec2 gravity;
+uniform float drag;
+uniform float quadraticDrag;
+uniform vec2 attractorPos;
+uniform float attractorStrength;
+uniform float attractorMaxAcc;
+
+struct State
+{
+    vec2 center;
+    float radius;
+    vec4 color;
+    vec2 vel;
+    float life;
+    vec4 colorVel;
+};
+
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// [0.0, 1.0)
+float random(inout uint rng)
+{
+    rng = hash(rng);
+    return float(rng >> 8) / 16777216.0;
+}
+
+vec2 random2(inout uint rng)
+{
+    float x = random(rng);
+    return vec2(x, random(rng));
+}
+
+vec4 random4(inout uint rng)
+{
+    vec2 xy = random2(rng);
+    return vec4(xy, random2(rng));
+}
+
+State spawnParticle(int index)
+{
+    uint rng = hash(uint(index) ^ hash(uint(seed)));
+
+    State state;
+    state.center = spawnPos + spawnSize * random2(rng);
+    state.radius = mix(radiusRange.x, radiusRange.y, random(rng));
+    state.vel = mix(velMin, velMax, random2(rng));
+    state.life = mix(lifeRange.x, lifeRange.y, random(rng));
+    state.color = mix(colorStartMin, colorStartMax, random4(rng));
+    vec4 colorEnd = mix(colorEndMin, colorEndMax, random4(rng));
+    state.colorVel = vec4(0.0);
+
+    // never dies
+    if(lifeRange.x < 0.0)
+    {
+        state.life = -1.0;
+    }
+    else
+    {
+        state.colorVel = (colorEnd - state.color) / state.life;
+    }
+
+    state.color += colorPerSpeed * length(state.vel);
+    return state;
+}
+
+void simulate(inout State state)
+{
+    // the speed term is recomputed for the new velocity
+    state.color -= colorPerSpeed * length(state.vel);
+
+    vec2 acc = gravity;
+    vec2 toAttractor = attractorPos - state.center;
+    float distance2 = dot(toAttractor, toAttractor);
+
+    if(attractorStrength != 0.0 && distance2 > 0.000001)
+    {
+        float accLength = min(attractorMaxAcc, abs(attractorStrength) / distance2);
+        acc += toAttractor * inversesqrt(distance2) * accLength * sign(attractorStrength);
+    }
+
+    state.vel += acc * dt;
+    state.vel *= exp(-drag * dt);
+
+    float speed = length(state.vel);
+
+    if(quadraticDrag != 0.0 && speed > 0.000001)
+    {
+        state.vel -= state.vel / speed * min(speed, quadraticDrag * speed * speed * dt);
+    }
+
+    state.center += state.vel * dt;
+    state.color += state.colorVel * dt + colorPerSpeed * length(state.vel);
+
+    if(state.life > 0.0)
+    {
+        state.life = max(state.life - dt, 0.0);
+    }
+}
+
+// the dead particles get the zero matrix (nothing is rendered)
+mat4 getMatrix(State state)
+{
+    if(state.life == 0.0)
+        return mat4(0.0);
+
+    float size = state.radius * 2.0;
+    vec2 pos = state.center - state.radius;
+    return mat4(vec4(size, 0.0, 0.0, 0.0), vec4(0.0, size, 0.0, 0.0), vec4(0.0, 0.0, 1.0, 0.0), vec4(pos, 0.0, 1.0));
+}
+)";
+
+const char* const computeSource = R"(
+
+layout(local_size_x = 256) in;
+
+// the same layout as GpuParticles::Particle
+struct Particle
+{
+    float matrix[16];
+    float color[4];
+    float normTexRect[4];
+    float layer;
+    float vel[2];
+    float life;
+    float colorVel[4];
+};
+
+layout(std430, binding = 0) readonly buffer BufferIn
+{
+    Particle particlesIn[];
+};
+
+layout(std430, binding = 1) writeonly buffer BufferOut
+{
+    Particle particlesOut[];
+};
+
+layout(binding = 0, offset = 0) uniform atomic_uint numSpawned;
+
+void main()
+{
+    int index = int(gl_GlobalInvocationID.x);
+
+    if(index >= numParticles)
+        return;
+
+    Particle particle = particlesIn[index];
+
+    State state;
+    state.radius = particle.matrix[0] * 0.5;
+    state.center = vec2(particle.matrix[12], particle.matrix[13]) + state.radius;
+    state.color = vec4(particle.color[0], particle.color[1], particle.color[2], particle.color[3]);
+    state.vel = vec2(particle.vel[0], particle.vel[1]);
+    state.life = particle.life;
+    state.colorVel = vec4(particle.colorVel[0], particle.colorVel[1], particle.colorVel[2], particle.colorVel[3]);
+
+    if(state.life != 0.0)
+    {
+        simulate(state);
+    }
+
+    if(state.life == 0.0 && atomicCounterIncrement(numSpawned) < uint(numToSpawn))
+    {
+        state = spawnParticle(index);
+    }
+
+    mat4 matrix = getMatrix(state);
+
+    for(int i = 0; i < 16; ++i)
+    {
+        particle.matrix[i] = matrix[i / 4][i % 4];
+    }
+
+    for(int i = 0; i < 4; ++i)
+    {
+        particle.color[i] = state.color[i];
+        particle.colorVel[i] = state.colorVel[i];
+    }
+
+    particle.normTexRect = float[4](0.0, 0.0, 1.0, 1.0);
+    particle.layer = 0.0;
+    particle.vel = float[2](state.vel.x, state.vel.y);
+    particle.life = state.life;
+
+    particlesOut[index] = particle;
+}
+)";
+
+const char* const feedbackSource = R"(
+
+layout(location = 0) in mat4 matrix;
+layout(location = 4) in vec4 color;
+layout(location = 7) in vec2 vel;
+layout(location = 8) in float life;
+layout(location = 9) in vec4 colorVel;
+
+// the first slot of the spawn ring
+uniform int spawnStart;
+
+// the same layout as GpuParticles::Particle
+out mat4 tfMatrix;
+out vec4 tfColor;
+out vec4 tfNormTexRect;
+out float tfLayer;
+out vec2 tfVel;
+out float tfLife;
+out vec4 tfColorVel;
+
+void main()
+{
+    int index = gl_VertexID;
+
+    State state;
+    state.radius = matrix[0][0] * 0.5;
+    state.center = matrix[3].xy + state.radius;
+    state.color = color;
+    state.vel = vel;
+    state.life = life;
+    state.colorVel = colorVel;
+
+    if(state.life != 0.0)
+    {
+        simulate(state);
+    }
+
+    if((index - spawnStart + numParticles) % numParticles < numToSpawn)
+    {
+        state = spawnParticle(index);
+    }
+
+    tfMatrix = getMatrix(state);
+    tfColor = state.color;
+    tfNormTexRect = vec4(0.0, 0.0, 1.0, 1.0);
+    tfLayer = 0.0;
+    tfVel = state.vel;
+    tfLife = state.life;
+    tfColorVel = state.colorVel;
+}
+)";
+
+GpuParticles::GpuParticles(const int maxParticles, const Backend backend):
+    maxParticles_(maxParticles),
+    backend_(backend)
+{
+    static_assert(sizeof(Particle) == 32 * sizeof(float));
+    assert(maxParticles > 0);
+
+    if(backend_ == Backend::Auto)
+    {
+        backend_ = GLAD_GL_VERSION_4_3 ? Backend::Compute : Backend::TransformFeedback;
+    }
+
+    if(backend_ == Backend::Compute)
+    {
+        shader_ = Shader({std::string("#compute\n#version 430\n") + commonSource + computeSource},
+                         "hppv::GpuParticles::shader_");
+    }
+    else
+    {
+        shader_ = Shader({std::string("#vertex\n#version 330\n") + commonSource + feedbackSource},
+                         "hppv::GpuParticles::shader_", {},
+                         {"tfMatrix", "tfColor", "tfNormTexRect", "tfLayer", "tfVel", "tfLife", "tfColorVel"});
+    }
+
+    // all dead
+    const std::vector<float> zeros(maxParticles * sizeof(Particle) / sizeof(float), 0.f);
+
+    for(auto& buffer: buffers_)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer.getId());
+        glBufferData(GL_ARRAY_BUFFER, zeros.size() * sizeof(float), zeros.data(), GL_DYNAMIC_COPY);
+    }
+
+    if(backend_ == Backend::Compute)
+    {
+        glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, boCounter_.getId());
+        glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+        return;
+    }
+
+    for(auto i = 0; i < 2; ++i)
+    {
+        glBindVertexArray(vaos_[i].getId());
+        glBindBuffer(GL_ARRAY_BUFFER, buffers_[i].getId());
+
+        for(auto j = 0; j < 4; ++j)
+        {
+            glVertexAttribPointer(j, 4, GL_FLOAT, GL_FALSE, sizeof(Particle),
+                                  reinterpret_cast<const void*>(offsetof(Particle, instance)
+                                  + offsetof(Renderer::Instance, matrix) + j * sizeof(glm::vec4)));
+        }
+
+        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Particle),
+                              reinterpret_cast<const void*>(offsetof(Particle, instance)
+                              + offsetof(Renderer::Instance, color)));
+
+        glVertexAttribPointer(7, 2, GL_FLOAT, GL_FALSE, sizeof(Particle),
+                              reinterpret_cast<const void*>(offsetof(Particle, vel)));
+
+        glVertexAttribPointer(8, 1, GL_FLOAT, GL_FALSE, sizeof(Particle),
+                              reinterpret_cast<const void*>(offsetof(Particle, life)));
+
+        glVertexAttribPointer(9, 4, GL_FLOAT, GL_FALSE, sizeof(Particle),
+                              reinterpret_cast<const void*>(offsetof(Particle, colorVel)));
+
+        for(const auto location: {0, 1, 2, 3, 4, 7, 8, 9})
+        {
+            glEnableVertexAttribArray(location);
+        }
+    }
+}
+
+void GpuParticles::update(const float dt)
+{
+    spawnAccumulator_ += spawn.hz * dt;
+    const int numToSpawn = spawnAccumulator_;
+    spawnAccumulator_ -= numToSpawn;
+
+    ++seed_;
+
+    shader_.bind();
+    setUniforms(dt, std::min(numToSpawn, maxParticles_));
+
+    if(backend_ == Backend::Compute)
+    {
+        const GLuint zero = 0;
+        glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, boCounter_.getId());
+        glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(zero), &zero);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers_[current_].getId());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers_[!current_].getId());
+        glDispatchCompute((maxParticles_ + LocalSize - 1) / LocalSize, 1, 1);
+
+        // the next update reads the buffer as SSBO, the Renderer as vertex attributes
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT |
+                        GL_ATOMIC_COUNTER_BARRIER_BIT);
+    }
+    else
+    {
+        shader_.uniform1i("spawnStart", spawnStart_);
+
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(vaos_[current_].getId());
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers_[!current_].getId());
+
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, maxParticles_);
+        glEndTransformFeedback();
+
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glDisable(GL_RASTERIZER_DISCARD);
+
+        spawnStart_ = (spawnStart_ + std::min(numToSpawn, maxParticles_)) % maxParticles_;
+    }
+
+    current_ = !current_;
+}
+
+void GpuParticles::render(Renderer& renderer)
+{
+    renderer.cache(buffers_[current_], maxParticles_, sizeof(Particle));
+}
+
+void GpuParticles::setUniforms(const float dt, const int numToSpawn)
+{
+    shader_.uniform1f("dt", dt);
+    shader_.uniform1i("numParticles", maxParticles_);
+    shader_.uniform1i("numToSpawn", numToSpawn);
+    shader_.uniform1i("seed", seed_);
+
+    shader_.uniform2f("spawnPos", spawn.pos);
+    shader_.uniform2f("spawnSize", spawn.size);
+    shader_.uniform2f("lifeRange", {life.min, life.max});
+    shader_.uniform2f("radiusRange", {radius.min, radius.max});
+    shader_.uniform2f("velMin", vel.min);
+    shader_.uniform2f("velMax", vel.max);
+    shader_.uniform4f("colorStartMin", colorStart.min);
+    shader_.uniform4f("colorStartMax", colorStart.max);
+    shader_.uniform4f("colorEndMin", colorEnd.min);
+    shader_.uniform4f("colorEndMax", colorEnd.max);
+    shader_.uniform4f("colorPerSpeed", colorPerSpeed);
+
+    shader_.uniform2f("gravity", gravity);
+    shader_.uniform1f("drag", drag);
+    shader_.uniform1f("quadraticDrag", quadraticDrag);
+    shader_.uniform2f("attractorPos", attractor.pos);
+    shader_.uniform1f("attractorStrength", attractor.strength);
+    shader_.uniform1f("attractorMaxAcc", attractor.maxAcc);
+}
+
+} // namespace hppv
@@ -0,0 +1,233 @@
+#include <cassert>
+
+#include <hppv/Jobs.hpp>
+
+namespace hppv
+{
+
+struct Jobs::Job
+{
+    Function function;
+    std::atomic_int numDependencies = 1; // + 1 until scheduled
+    std::atomic_bool done = false;
+    std::mutex mutex;
+    std::vector<Id> dependents; // guarded by mutex, until done
+};
+
+// the queue of the current thread, 0 - not a worker of the pool
+thread_local const Jobs* currentJobs = nullptr;
+thread_local int currentQueue = 0;
+
+Jobs::Jobs(int numThreads)
+{
+    if(numThreads <= 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for(auto i = 0; i < numThreads; ++i)
+    {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+
+    for(auto i = 1; i < numThreads; ++i)
+    {
+        threads_.emplace_back(&Jobs::work, this, i);
+    }
+}
+
+Jobs::~Jobs()
+{
+    waitAll();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+
+    condition_.notify_all();
+
+    for(auto& thread: threads_)
+    {
+        thread.join();
+    }
+}
+
+Jobs::Id Jobs::schedule(Function function, const std::initializer_list<Id> dependencies)
+{
+    return schedule(std::move(function), std::vector<Id>(dependencies));
+}
+
+Jobs::Id Jobs::schedule(Function function, const std::vector<Id>& dependencies)
+{
+    auto job = std::make_shared<Job>();
+    job->function = std::move(function);
+    ++numUnfinished_;
+
+    for(const auto& dependency: dependencies)
+    {
+        assert(dependency);
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+
+        if(!dependency->done)
+        {
+            ++job->numDependencies;
+            dependency->dependents.push_back(job);
+        }
+    }
+
+    if(--job->numDependencies == 0)
+    {
+        push(job);
+    }
+
+    return job;
+}
+
+void Jobs::wait(const Id& id)
+{
+    waitUntil([&id]{return id->done.load();});
+}
+
+void Jobs::waitAll()
+{
+    waitUntil([this]{return numUnfinished_ == 0;});
+}
+
+bool Jobs::isDone(const Id& id) const
+{
+    return id->done;
+}
+
+void Jobs::push(Id job)
+{
+    // first, so numQueued_ is never below the number of the queued jobs
+    ++numQueued_;
+
+    {
+        auto& queue = *queues_[currentJobs == this ? currentQueue : 0];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+
+    // a thread can't miss the notification between checking the predicate and sleeping
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+
+    condition_.notify_one();
+}
+
+Jobs::Id Jobs::pop()
+{
+    if(numQueued_ <= 0)
+        return {};
+
+    const auto own = currentJobs == this ? currentQueue : 0;
+    const int numQueues = queues_.size();
+
+    for(auto i = 0; i < numQueues; ++i)
+    {
+        auto& queue = *queues_[(own + i) % numQueues];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if(queue.jobs.empty())
+            continue;
+
+        Id job;
+
+        if(i == 0)
+        {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        }
+        else
+        {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        }
+
+        --numQueued_;
+        return job;
+    }
+
+    return {};
+}
+
+void Jobs::execute(const Id& job)
+{
+    job->function();
+    job->function = nullptr; // releases the captures
+
+    std::vector<Id> dependents;
+
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->done = true;
+        dependents.swap(job->dependents);
+    }
+
+    for(auto& dependent: dependents)
+    {
+        if(--dependent->numDependencies == 0)
+        {
+            push(std::move(dependent));
+        }
+    }
+
+    --numUnfinished_;
+
+    if(numWaiting_)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+        }
+
+        condition_.notify_all();
+    }
+}
+
+template<typename P>
+void Jobs::waitUntil(const P& predicate)
+{
+    while(!predicate())
+    {
+        if(auto job = pop())
+        {
+            execute(job);
+            continue;
+        }
+
+        ++numWaiting_;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this, &predicate]{return numQueued_ > 0 || predicate();});
+        }
+
+        --numWaiting_;
+    }
+}
+
+void Jobs::work(const int queue)
+{
+    currentJobs = this;
+    currentQueue = queue;
+
+    while(true)
+    {
+        if(auto job = pop())
+        {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this]{return numQueued_ > 0 || quit_;});
+
+        if(quit_)
+            return;
+    }
+}
+
+} // namespace hppv
@@ -20,32 +20,54 @@ int ImTextCharFromUtf8(unsigned int* out_char, const char* in_text, const char*
 namespace hppv
 {
 
-glm::vec2 Text::getSize() const
+glm::vec2 getTextSize(const Font& font, const std::string_view str, const float scale)
 {
     auto x = 0.f;
-    const auto lineHeight = font->getLineHeight() * scale;
+    const auto lineHeight = font.getLineHeight() * scale;
     glm::vec2 size(0.f, lineHeight);
+    const auto kerning = font.hasKerning();
+    unsigned int prev = 0;
+    const auto* const end = str.data() + str.size();
 
-    for(const auto c: text)
+    for(const auto* s = str.data(); s < end;)
     {
+        unsigned int c;
+        s += ImTextCharFromUtf8(&c, s, end);
+
+        if(c == 0)
+            break;
+
         if(c == '\n')
         {
             size.x = std::max(size.x, x);
             x = 0.f;
             size.y += lineHeight;
+            prev = 0;
             continue;
         }
 
-        const auto glyph = font->getGlyph(c);
+        if(kerning && prev)
+        {
+            x += font.getKerning(prev, c) * scale;
+        }
+
+        const auto glyph = font.getGlyph(c);
         x += glyph.advance * scale;
+        prev = c;
     }
 
     size.x = std::max(size.x, x);
     return size;
 }
 
+glm::vec2 Text::getSize() const
+{
+    return getTextSize(*font, text, scale);
+}
+
 Renderer::Instance createInstance(const glm::vec2 pos, const glm::vec2 size, const float rotation, const glm::vec2 rotationPoint,
-                                  const glm::vec4 color, const glm::vec4 texRect, const glm::vec2 texSize)
+                                  const glm::vec4 color, const glm::vec4 texRect, const glm::vec2 texSize,
+                                  const int layer = 0)
 {
     Renderer::Instance i;
 
@@ -69,22 +91,33 @@ Renderer::Instance createInstance(const glm::vec2 pos, const glm::vec2 size, con
     i.normTexRect.z = texRect.z / texSize.x;
     i.normTexRect.w = texRect.w / texSize.y;
 
+    i.layer = layer;
+
     return i;
 }
 
 Renderer::Renderer():
-    shaderBasic_({vInstancesSource, fBasicSource}, "hppv::Renderer::shaderBasic_"),
-    shaderSdf_({vInstancesSource, fSdfSource}, "hppv::Renderer::shaderSdf_"),
-    shaderVertices_({vVerticesSource, fVerticesSource}, "hppv::Renderer::shaderVertices_")
+    shadersBasic_({vInstancesSource, fBasicSource}, "hppv::Renderer::shadersBasic_"),
+    shadersSdf_({vInstancesSource, fSdfSource}, "hppv::Renderer::shadersSdf_"),
+    shadersVertices_({vVerticesSource, fVerticesSource}, "hppv::Renderer::shadersVertices_")
 {
+    // the most common ones, so they can be compiled in parallel (see Shader::setDeferredCompilation())
+    for(const auto mode: {Render::Color, Render::Tex, Render::CircleColor, Render::Font, Render::VerticesColor})
+    {
+        getShader(mode, false, false);
+    }
+
     glSamplerParameteri(samplerLinear_.getId(), GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glSamplerParameteri(samplerLinear_.getId(), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     glSamplerParameteri(samplerNearest_.getId(), GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glSamplerParameteri(samplerNearest_.getId(), GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
+    glSamplerParameteri(samplerTrilinear_.getId(), GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glSamplerParameteri(samplerTrilinear_.getId(), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
     {
-        const GLuint ids[] = {samplerNearest_.getId(), samplerLinear_.getId()};
+        const GLuint ids[] = {samplerNearest_.getId(), samplerLinear_.getId(), samplerTrilinear_.getId()};
 
         for(const auto id: ids)
         {
@@ -107,7 +140,12 @@ Renderer::Renderer():
         auto& batch = batches_.back();
         batch.primitive = GL_TRIANGLES;
         batch.vao = &vaoInstances_;
-        batch.shader = &shaderBasic_;
+        batch.instancesBuffer = nullptr;
+        batch.instancesStride = sizeof(Instance);
+        batch.stencil = Stencil::Disabled;
+        batch.stencilValue = 0;
+        batch.shader = nullptr;
+        batch.mode = Render::Color;
         batch.srcAlpha = GL_ONE;
         batch.dstAlpha = GL_ONE_MINUS_SRC_ALPHA;
         batch.premultiplyAlpha = false;
@@ -143,13 +181,40 @@ Renderer::Renderer():
     glEnableVertexAttribArray(0);
 
     glBindBuffer(GL_ARRAY_BUFFER, boInstances_.getId());
+    setInstanceAttributes(sizeof(Instance));
+
+    // the instance attributes are set in flush()
+    glBindVertexArray(vaoInstancesBuffer_.getId());
+    glBindBuffer(GL_ARRAY_BUFFER, boQuad_.getId());
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glEnableVertexAttribArray(0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, boVertices_.getId());
 
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+    glBindVertexArray(vaoVertices_.getId());
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), nullptr);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          reinterpret_cast<const void*>(offsetof(Vertex, texCoord)));
+
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          reinterpret_cast<const void*>(offsetof(Vertex, color)));
+
+    glEnableVertexAttribArray(2);
+}
+
+void Renderer::setInstanceAttributes(const std::size_t stride)
+{
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride,
                           reinterpret_cast<const void*>(offsetof(Instance, color)));
     glEnableVertexAttribArray(1);
     glVertexAttribDivisor(1, 1);
 
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride,
                           reinterpret_cast<const void*>(offsetof(Instance, normTexRect)));
     glEnableVertexAttribArray(2);
     glVertexAttribDivisor(2, 1);
@@ -163,37 +228,25 @@ Renderer::Renderer():
     glEnableVertexAttribArray(6);
     glVertexAttribDivisor(6, 1);
 
-    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride,
                           reinterpret_cast<const void*>(offsetof(Instance, matrix)));
 
-    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, stride,
                           reinterpret_cast<const void*>(offsetof(Instance, matrix)
                           + sizeof(glm::vec4)));
 
-    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, stride,
                           reinterpret_cast<const void*>(offsetof(Instance, matrix)
                           + 2 * sizeof(glm::vec4)));
 
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride,
                           reinterpret_cast<const void*>(offsetof(Instance, matrix)
                           + 3 * sizeof(glm::vec4)));
 
-    glBindBuffer(GL_ARRAY_BUFFER, boVertices_.getId());
-
-    glBindVertexArray(vaoVertices_.getId());
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), nullptr);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          reinterpret_cast<const void*>(offsetof(Vertex, texCoord)));
-
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          reinterpret_cast<const void*>(offsetof(Vertex, color)));
-
-    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void*>(offsetof(Instance, layer)));
+    glEnableVertexAttribArray(7);
+    glVertexAttribDivisor(7, 1);
 }
 
 void Renderer::scissor(glm::ivec4 scissor)
@@ -218,27 +271,6 @@ void Renderer::viewport(const Framebuffer& framebuffer)
     getBatchToUpdate().viewport = {0, 0, framebuffer.getSize()};
 }
 
-void Renderer::shader(const Render mode)
-{
-    const auto modeId = static_cast<int>(mode);
-    auto& batch = getBatchToUpdate();
-
-    if(modeId < static_cast<int>(Render::Sdf))
-    {
-        batch.shader = &shaderBasic_;
-    }
-    else if(modeId < static_cast<int>(Render::VerticesColor))
-    {
-        batch.shader = &shaderSdf_;
-    }
-    else
-    {
-        batch.shader = &shaderVertices_;
-    }
-
-    uniform1i("mode", modeId);
-}
-
 void Renderer::uniform1i(const std::string& name, const int value)
 {
     uniforms_.emplace_back(Uniform::I1, name);
@@ -327,6 +359,16 @@ void Renderer::sampler(GLsampler& sampler, const GLenum unit)
     ++batch.texUnits.count;
 }
 
+void Renderer::sampler(const Sample mode, const GLenum unit)
+{
+    switch(mode)
+    {
+    case Sample::Linear: sampler(samplerLinear_, unit); break;
+    case Sample::Nearest: sampler(samplerNearest_, unit); break;
+    case Sample::Trilinear: sampler(samplerTrilinear_, unit);
+    }
+}
+
 void Renderer::cache(const Sprite* sprite, const std::size_t count)
 {
     auto& batch = batches_.back();
@@ -345,7 +387,7 @@ void Renderer::cache(const Sprite* sprite, const std::size_t count)
     for(auto i = start; i < end; ++i, ++sprite)
     {
         instances_[i] = createInstance(sprite->pos, sprite->size, sprite->rotation, sprite->rotationPoint,
-                                       sprite->color, sprite->texRect, texSize);
+                                       sprite->color, sprite->texRect, texSize, sprite->layer);
     }
 }
 
@@ -367,17 +409,79 @@ void Renderer::cache(const Circle* circle, const std::size_t count)
     for(auto i = start; i < end; ++i, ++circle)
     {
         instances_[i] = createInstance(circle->center - circle->radius, glm::vec2(circle->radius * 2.f), 0.f, {},
-                                       circle->color, circle->texRect, texSize);
+                                       circle->color, circle->texRect, texSize, circle->layer);
+    }
+}
+
+// text.text and text.pos are not used, str and pos are used instead
+// instances must have a space for str.size() elements
+// returns the number of instances written
+std::size_t layoutText(Renderer::Instance* const instances, const Text& text, const std::string_view str,
+                       const glm::vec2 pos, const glm::vec2 texSize)
+{
+    const auto& font = *text.font;
+    const auto kerning = font.hasKerning();
+    const auto lineHeight = font.getLineHeight() * text.scale;
+
+    // needed only for the rotation
+    const auto halfTextSize = text.rotation != 0.f ? getTextSize(font, str, text.scale) / 2.f : glm::vec2(0.f);
+
+    auto penPos = pos;
+    std::size_t count = 0;
+    unsigned int prev = 0;
+    const auto* const end = str.data() + str.size();
+
+    for(const auto* s = str.data(); s < end;)
+    {
+        unsigned int c;
+        s += ImTextCharFromUtf8(&c, s, end);
+
+        if(c == 0)
+            break;
+
+        if(c == '\n')
+        {
+            penPos.x = pos.x;
+            penPos.y += lineHeight;
+            prev = 0;
+            continue;
+        }
+
+        if(kerning && prev)
+        {
+            penPos.x += font.getKerning(prev, c) * text.scale;
+        }
+
+        const auto glyph = font.getGlyph(c);
+
+        const auto glyphPos = penPos + glm::vec2(glyph.offset) * text.scale;
+        const auto size = glm::vec2(glyph.texRect.z, glyph.texRect.w) * text.scale;
+
+        instances[count] = createInstance(glyphPos, size, text.rotation, text.rotationPoint + pos + halfTextSize
+                                          - glyphPos - size / 2.f, // this correction is needed, see createInstance()
+                                          text.color, glyph.texRect, texSize);
+
+        penPos.x += glyph.advance * text.scale;
+        prev = c;
+        ++count;
     }
+
+    return count;
 }
 
-void Renderer::cache(const Text& text)
+void Renderer::cache(const Text* const text, const std::size_t count)
 {
     auto& batch = batches_.back();
     assert(batch.vao == &vaoInstances_);
 
     {
-        const auto end = batch.instances.start + batch.instances.count + text.text.size();
+        // UTF-8 - number of bytes >= number of glyphs
+        auto end = batch.instances.start + batch.instances.count;
+
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            end += text[i].text.size();
+        }
 
         if(end > instances_.size())
         {
@@ -385,37 +489,43 @@ void Renderer::cache(const Text& text)
         }
     }
 
-    auto penPos = text.pos;
-    auto i = batch.instances.start + batch.instances.count;
-    const auto halfTextSize = text.getSize() / 2.f;
+    const glm::vec2 texSize = texUnits_.back().texture->getSize();
+    auto* const instances = instances_.data() + batch.instances.start;
 
-    for(const auto* s = text.text.data(); *s;)
+    for(std::size_t i = 0; i < count; ++i)
     {
-        unsigned int c;
-        s += ImTextCharFromUtf8(&c, s, nullptr);
+        batch.instances.count += layoutText(instances + batch.instances.count, text[i], text[i].text, text[i].pos,
+                                            texSize);
+    }
+}
 
-        if(c == 0)
-            break;
+void Renderer::cache(const Text& text, const std::string_view* const strings, const glm::vec2* const positions,
+                     const std::size_t count)
+{
+    auto& batch = batches_.back();
+    assert(batch.vao == &vaoInstances_);
 
-        if(c == '\n')
+    {
+        auto end = batch.instances.start + batch.instances.count;
+
+        for(std::size_t i = 0; i < count; ++i)
         {
-            penPos.x = text.pos.x;
-            penPos.y += text.font->getLineHeight() * text.scale;
-            continue;
+            end += strings[i].size();
         }
 
-        const auto glyph = text.font->getGlyph(c);
-
-        const auto pos = penPos + glm::vec2(glyph.offset) * text.scale;
-        const auto size = glm::vec2(glyph.texRect.z, glyph.texRect.w) * text.scale;
+        if(end > instances_.size())
+        {
+            instances_.resize(end);
+        }
+    }
 
-        instances_[i] = createInstance(pos, size, text.rotation, text.rotationPoint + text.pos + halfTextSize - pos
-                                       - size / 2.f, // this correction is needed, see createInstance()
-                                       text.color, glyph.texRect, texUnits_.back().texture->getSize());
+    const glm::vec2 texSize = texUnits_.back().texture->getSize();
+    auto* const instances = instances_.data() + batch.instances.start;
 
-        penPos.x += glyph.advance * text.scale;
-        ++i;
-        ++batch.instances.count;
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        batch.instances.count += layoutText(instances + batch.instances.count, text, strings[i], positions[i],
+                                            texSize);
     }
 }
 
@@ -438,6 +548,23 @@ void Renderer::cache(const Vertex* vertex, const std::size_t count)
     }
 }
 
+void Renderer::cache(GLbo& instances, const std::size_t count, const std::size_t stride)
+{
+    if(!count)
+        return;
+
+    {
+        auto& batch = getBatchToUpdate();
+        assert(batch.vao == &vaoInstances_);
+        batch.instancesBuffer = &instances;
+        batch.instancesStride = stride;
+        batch.instances.count = count;
+    }
+
+    // the next instances go to instances_ again
+    getBatchToUpdate();
+}
+
 void Renderer::flush()
 {
     if(batches_.front().instances.count == 0 && batches_.front().vertices.count == 0)
@@ -471,21 +598,36 @@ void Renderer::flush()
             glDisable(GL_SCISSOR_TEST);
         }
 
-        glViewport(batch.viewport.x, batch.viewport.y, batch.viewport.z, batch.viewport.w);
-
-        auto& shader = *batch.shader;
-        shader.bind();
-
-        if(&shader == &shaderBasic_ || &shader == &shaderVertices_)
+        if(batch.stencil == Stencil::Disabled)
         {
-            shader.uniform1i("premultiplyAlpha", batch.premultiplyAlpha);
+            glDisable(GL_STENCIL_TEST);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
         }
-
-        if(&shader == &shaderBasic_)
+        else
         {
-            shader.uniform1i("antialiasedSprites", batch.antialiasedSprites);
+            glEnable(GL_STENCIL_TEST);
+            glStencilMask(0xff);
+
+            if(batch.stencil == Stencil::Write)
+            {
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                glStencilFunc(GL_ALWAYS, batch.stencilValue, 0xff);
+                glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+            }
+            else
+            {
+                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                glStencilFunc(batch.stencil == Stencil::Equal ? GL_EQUAL : GL_NOTEQUAL, batch.stencilValue, 0xff);
+                glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+            }
         }
 
+        glViewport(batch.viewport.x, batch.viewport.y, batch.viewport.z, batch.viewport.w);
+
+        auto& shader = batch.shader ? *batch.shader : getShader(batch.mode, batch.premultiplyAlpha,
+                                                                 batch.antialiasedSprites);
+        shader.bind();
+
         if(batch.vao == &vaoInstances_)
         {
             shader.uniform1i("flipTexRectX", batch.flipTexRectX);
@@ -535,6 +677,16 @@ void Renderer::flush()
         }
 
         glBlendFunc(batch.srcAlpha, batch.dstAlpha);
+
+        if(batch.instancesBuffer)
+        {
+            glBindVertexArray(vaoInstancesBuffer_.getId());
+            glBindBuffer(GL_ARRAY_BUFFER, batch.instancesBuffer->getId());
+            setInstanceAttributes(batch.instancesStride);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, batch.instances.count);
+            continue;
+        }
+
         glBindVertexArray(batch.vao->getId());
 
         if(batch.vao == &vaoInstances_)
@@ -547,6 +699,9 @@ void Renderer::flush()
         }
     }
 
+    glDisable(GL_STENCIL_TEST);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
     batches_.erase(batches_.begin(), batches_.end() - 1);
     uniforms_.clear();
 
@@ -587,7 +742,17 @@ Renderer::Batch& Renderer::getBatchToUpdate()
     auto& current = batches_.back();
     current = *(&current - 1);
 
-    current.instances.start += current.instances.count;
+    // the instances of a buffer object batch do not occupy instances_
+    if(current.instancesBuffer)
+    {
+        current.instancesBuffer = nullptr;
+        current.instancesStride = sizeof(Instance);
+    }
+    else
+    {
+        current.instances.start += current.instances.count;
+    }
+
     current.instances.count = 0;
     current.texUnits.start += current.texUnits.count;
     current.texUnits.count = 0;
@@ -599,4 +764,60 @@ Renderer::Batch& Renderer::getBatchToUpdate()
     return current;
 }
 
+Shader& Renderer::getShader(const Render mode, bool premultiplyAlpha, bool antialiasedSprites)
+{
+    // the options some modes do not use, so they do not get the redundant programs
+
+    switch(mode)
+    {
+    case Render::Tex:
+    case Render::CircleTex:
+    case Render::VerticesTex:
+    case Render::TexArray:
+    case Render::CircleTexArray: break;
+    default: premultiplyAlpha = false;
+    }
+
+    switch(mode)
+    {
+    case Render::Color:
+    case Render::Tex:
+    case Render::TexArray: break;
+    default: antialiasedSprites = false;
+    }
+
+    const auto modeId = static_cast<int>(mode);
+    auto*& shader = shaders_[modeId][premultiplyAlpha | antialiasedSprites << 1];
+
+    if(shader)
+        return *shader;
+
+    auto defines = "#define MODE " + std::to_string(modeId) + '\n';
+
+    if(premultiplyAlpha)
+    {
+        defines += "#define PREMULTIPLY_ALPHA\n";
+    }
+
+    if(antialiasedSprites)
+    {
+        defines += "#define ANTIALIASED_SPRITES\n";
+    }
+
+    if(mode < Render::Sdf || mode >= Render::TexArray)
+    {
+        shader = &shadersBasic_.get(defines);
+    }
+    else if(mode < Render::VerticesColor)
+    {
+        shader = &shadersSdf_.get(defines);
+    }
+    else
+    {
+        shader = &shadersVertices_.get(defines);
+    }
+
+    return *shader;
+}
+
 } // namespace hppv
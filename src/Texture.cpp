@@ -1,21 +1,56 @@
 #include <iostream>
+#include <cassert>
+#include <algorithm> // std::max
+
+#include <cstring> // std::memcmp
+
+#include <fcntl.h> // open
+#include <unistd.h> // close
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+
+#include <glm/common.hpp> // glm::max
 
 #include <hppv/Texture.hpp>
+#include <hppv/TextureFile.hpp>
+#include <hppv/Deleter.hpp>
 #include <hppv/glad.h>
 
+#include "loadImage.hpp"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 namespace hppv
 {
 
-Texture::Texture(const std::string& filename)
+int getNumMipmapLevels(const glm::ivec2 size)
+{
+    auto numLevels = 1;
+
+    for(auto max = std::max(size.x, size.y); max > 1; max /= 2)
+    {
+        ++numLevels;
+    }
+
+    return numLevels;
+}
+
+Texture::Texture(const std::string& filename, const bool mipmaps)
 {
     bind();
 
-    stbi_set_flip_vertically_on_load(true);
+    if(filename.find(".hptx") != std::string::npos)
+    {
+        if(!loadHptx(filename))
+        {
+            createDefault();
+        }
+
+        return;
+    }
 
-    unsigned char* const data = stbi_load(filename.c_str(), &size_.x, &size_.y, nullptr, 4);
+    unsigned char* const data = loadImage(filename, size_);
 
     if(!data)
     {
@@ -24,20 +59,28 @@ Texture::Texture(const std::string& filename)
         return;
     }
 
-    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, size_.x, size_.y);
+    numLevels_ = mipmaps ? getNumMipmapLevels(size_) : 1;
+
+    glTexStorage2D(GL_TEXTURE_2D, numLevels_, GL_RGBA8, size_.x, size_.y);
 
     glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size_.x, size_.y, GL_RGBA,
                     GL_UNSIGNED_BYTE, data);
 
     stbi_image_free(data);
+
+    if(mipmaps)
+    {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
 }
 
-Texture::Texture(const GLenum format, const glm::ivec2 size):
-    size_(size)
+Texture::Texture(const GLenum format, const glm::ivec2 size, const bool mipmaps):
+    size_(size),
+    numLevels_(mipmaps ? getNumMipmapLevels(size) : 1)
 {
     bind();
 
-    glTexStorage2D(GL_TEXTURE_2D, 1, format, size.x, size.y);
+    glTexStorage2D(GL_TEXTURE_2D, numLevels_, format, size.x, size.y);
 }
 
 Texture::Texture()
@@ -46,10 +89,90 @@ Texture::Texture()
     createDefault();
 }
 
+Texture::Texture(Array, const std::vector<std::string>& filenames, const bool mipmaps):
+    size_(0, 0),
+    numLayers_(filenames.size())
+{
+    assert(numLayers_);
+
+    std::vector<unsigned char> defaultLayer;
+
+    for(auto i = 0; i < numLayers_; ++i)
+    {
+        const auto& filename = filenames[i];
+        glm::ivec2 size;
+        unsigned char* const data = loadImage(filename, size);
+
+        if(!data)
+        {
+            std::cout << "Texture: stbi_load() failed, filename = " << filename << std::endl;
+        }
+
+        if(i == 0)
+        {
+            size_ = data ? size : glm::ivec2(1, 1);
+            numLevels_ = mipmaps ? getNumMipmapLevels(size_) : 1;
+            bind();
+            glTexStorage3D(GL_TEXTURE_2D_ARRAY, numLevels_, GL_RGBA8, size_.x, size_.y, numLayers_);
+        }
+
+        if(data && size != size_)
+        {
+            std::cout << "Texture: array layer size mismatch, filename = " << filename << std::endl;
+        }
+
+        if(data && size == size_)
+        {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, size_.x, size_.y, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        }
+        else
+        {
+            if(defaultLayer.empty())
+            {
+                defaultLayer.resize(size_.x * size_.y * 4);
+
+                for(std::size_t j = 0; j < defaultLayer.size(); j += 4)
+                {
+                    defaultLayer[j] = 0;
+                    defaultLayer[j + 1] = 255;
+                    defaultLayer[j + 2] = 0;
+                    defaultLayer[j + 3] = 255;
+                }
+            }
+
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, size_.x, size_.y, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                            defaultLayer.data());
+        }
+
+        stbi_image_free(data);
+    }
+
+    if(mipmaps)
+    {
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+}
+
+Texture::Texture(Array, const GLenum format, const glm::ivec2 size, const int numLayers, const bool mipmaps):
+    size_(size),
+    numLayers_(numLayers),
+    numLevels_(mipmaps ? getNumMipmapLevels(size) : 1)
+{
+    bind();
+
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, numLevels_, format, size.x, size.y, numLayers);
+}
+
+void Texture::generateMipmaps()
+{
+    bind();
+    glGenerateMipmap(numLayers_ ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D);
+}
+
 void Texture::bind(const GLuint unit)
 {
     glActiveTexture(GL_TEXTURE0 + unit);
-    glBindTexture(GL_TEXTURE_2D, texture_.getId());
+    glBindTexture(numLayers_ ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D, texture_.getId());
 }
 
 void Texture::createDefault()
@@ -64,4 +187,177 @@ void Texture::createDefault()
                     GL_UNSIGNED_BYTE, pixel);
 }
 
+void printHptxError(const std::string& filename, const char* const error)
+{
+    std::cout << "Texture: " << error << ", filename = " << filename << std::endl;
+}
+
+bool Texture::loadHptx(const std::string& filename)
+{
+    const auto fd = open(filename.c_str(), O_RDONLY);
+
+    if(fd == -1)
+    {
+        printHptxError(filename, "open() failed");
+        return false;
+    }
+
+    Deleter deleterFd;
+    deleterFd.set([fd]{close(fd);});
+
+    struct stat st;
+
+    if(fstat(fd, &st) == -1)
+    {
+        printHptxError(filename, "fstat() failed");
+        return false;
+    }
+
+    const std::size_t fileSize = st.st_size;
+
+    if(fileSize < sizeof(hptx::Header))
+    {
+        printHptxError(filename, "file too small");
+        return false;
+    }
+
+    auto* const mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if(mapping == MAP_FAILED)
+    {
+        printHptxError(filename, "mmap() failed");
+        return false;
+    }
+
+    Deleter deleterMapping;
+    deleterMapping.set([mapping, fileSize]{munmap(mapping, fileSize);});
+
+    const auto* const data = static_cast<const unsigned char*>(mapping);
+    const auto& header = *reinterpret_cast<const hptx::Header*>(data);
+
+    if(std::memcmp(header.magic, "HPTX", 4) != 0 || header.version != hptx::Version)
+    {
+        printHptxError(filename, "not a hptx file or unsupported version");
+        return false;
+    }
+
+    if(header.numLevels == 0 || header.numLevels > 32 ||
+       sizeof(hptx::Header) + header.numLevels * sizeof(hptx::Level) > fileSize)
+    {
+        printHptxError(filename, "corrupted level table");
+        return false;
+    }
+
+    GLenum internalFormat, format = 0;
+    auto compressed = false;
+    std::size_t bytesPerUnit; // per pixel or per 4x4 block (compressed)
+
+    switch(header.format)
+    {
+    case hptx::Format::Gray8: internalFormat = GL_R8; format = GL_RED; bytesPerUnit = 1; break;
+    case hptx::Format::GrayAlpha8: internalFormat = GL_RG8; format = GL_RG; bytesPerUnit = 2; break;
+    case hptx::Format::Rgba8: internalFormat = GL_RGBA8; format = GL_RGBA; bytesPerUnit = 4; break;
+
+    case hptx::Format::Bc1:
+        internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        compressed = true;
+        bytesPerUnit = 8;
+        break;
+
+    case hptx::Format::Bc3:
+        internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        compressed = true;
+        bytesPerUnit = 16;
+        break;
+
+    default:
+        printHptxError(filename, "unknown format");
+        return false;
+    }
+
+    {
+        GLint maxSize;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+        if(header.sizeX == 0 || header.sizeY == 0 ||
+           header.sizeX > GLuint(maxSize) || header.sizeY > GLuint(maxSize))
+        {
+            printHptxError(filename, "invalid size");
+            return false;
+        }
+    }
+
+    const glm::ivec2 fileTexSize(header.sizeX, header.sizeY);
+
+    if(int(header.numLevels) > getNumMipmapLevels(fileTexSize))
+    {
+        printHptxError(filename, "too many levels");
+        return false;
+    }
+
+    const auto* const levels = reinterpret_cast<const hptx::Level*>(data + sizeof(hptx::Header));
+
+    // the upload reads the number of bytes implied by the level size, not levels[i].size
+    for(auto i = 0u; i < header.numLevels; ++i)
+    {
+        const auto size = glm::max(glm::ivec2(1), fileTexSize / (1 << i));
+
+        const auto expectedSize = compressed ?
+                                  std::size_t((size.x + 3) / 4) * ((size.y + 3) / 4) * bytesPerUnit :
+                                  std::size_t(size.x) * size.y * bytesPerUnit;
+
+        if(levels[i].size != expectedSize || std::size_t(levels[i].offset) + levels[i].size > fileSize)
+        {
+            printHptxError(filename, "corrupted level data");
+            return false;
+        }
+    }
+
+    if(compressed && !GLAD_GL_EXT_texture_compression_s3tc)
+    {
+        printHptxError(filename, "EXT_texture_compression_s3tc extension is not supported");
+        return false;
+    }
+
+    size_ = fileTexSize;
+    numLevels_ = header.numLevels;
+
+    glTexStorage2D(GL_TEXTURE_2D, numLevels_, internalFormat, size_.x, size_.y);
+
+    if(header.format == hptx::Format::Gray8)
+    {
+        const GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+    else if(header.format == hptx::Format::GrayAlpha8)
+    {
+        const GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_GREEN};
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+
+    GLint unpackAlignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for(auto i = 0; i < numLevels_; ++i)
+    {
+        const auto size = glm::max(glm::ivec2(1), size_ / (1 << i));
+        const auto* const levelData = data + levels[i].offset;
+
+        if(compressed)
+        {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, size.x, size.y, internalFormat, levels[i].size,
+                                      levelData);
+        }
+        else
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, size.x, size.y, format, GL_UNSIGNED_BYTE, levelData);
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+
+    return true;
+}
+
 } // namespace hppv
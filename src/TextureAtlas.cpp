@@ -0,0 +1,128 @@
+#include <iostream>
+#include <algorithm> // std::remove_if, std::clamp
+
+#include <hppv/TextureAtlas.hpp>
+#include <hppv/glad.h>
+
+#include "loadImage.hpp"
+#include "imgui/stb_rect_pack.h"
+
+namespace hppv
+{
+
+TextureAtlas::TextureAtlas(const std::vector<std::string>& filenames, const glm::ivec2 pageSize)
+{
+    struct Image
+    {
+        const unsigned char* data;
+        glm::ivec2 size;
+        bool loaded;
+    };
+
+    const unsigned char defaultPixel[] = {0, 255, 0, 255};
+
+    std::vector<Image> images;
+    images.reserve(filenames.size());
+
+    for(const auto& filename: filenames)
+    {
+        Image image;
+        auto* const data = loadImage(filename, image.size);
+        image.data = data;
+        image.loaded = data;
+
+        if(!data)
+        {
+            std::cout << "TextureAtlas: stbi_load() failed, filename = " << filename << std::endl;
+        }
+        else if(image.size.x + 2 * Padding > pageSize.x || image.size.y + 2 * Padding > pageSize.y)
+        {
+            std::cout << "TextureAtlas: image is larger than the page, filename = " << filename << std::endl;
+            stbi_image_free(data);
+            image.loaded = false;
+        }
+
+        if(!image.loaded)
+        {
+            image.data = defaultPixel;
+            image.size = {1, 1};
+        }
+
+        images.push_back(image);
+    }
+
+    std::vector<stbrp_rect> rects(images.size());
+
+    for(std::size_t i = 0; i < rects.size(); ++i)
+    {
+        rects[i].id = i;
+        rects[i].w = images[i].size.x + 2 * Padding;
+        rects[i].h = images[i].size.y + 2 * Padding;
+    }
+
+    images_.resize(images.size());
+    std::vector<stbrp_node> nodes(pageSize.x);
+    std::vector<unsigned char> buffer;
+
+    while(rects.size())
+    {
+        stbrp_context context;
+        stbrp_init_target(&context, pageSize.x, pageSize.y, nodes.data(), nodes.size());
+        stbrp_pack_rects(&context, rects.data(), rects.size());
+
+        const int page = pages_.size();
+        pages_.emplace_back(GL_RGBA8, pageSize);
+
+        for(const auto& rect: rects)
+        {
+            if(!rect.was_packed)
+                continue;
+
+            const auto& image = images[rect.id];
+            buffer.resize(rect.w * rect.h * 4);
+
+            // image rows are flipped (loadImage()),
+            // the padding repeats the border pixels
+            for(auto j = 0; j < rect.h; ++j)
+            {
+                const auto srcY = std::clamp(j - Padding, 0, image.size.y - 1);
+
+                for(auto i = 0; i < rect.w; ++i)
+                {
+                    const auto srcX = std::clamp(i - Padding, 0, image.size.x - 1);
+
+                    for(auto c = 0; c < 4; ++c)
+                    {
+                        buffer[(j * rect.w + i) * 4 + c] = image.data[(srcY * image.size.x + srcX) * 4 + c];
+                    }
+                }
+            }
+
+            // convert to the OpenGL texture coordinate system
+            glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, pageSize.y - rect.y - rect.h, rect.w, rect.h, GL_RGBA,
+                            GL_UNSIGNED_BYTE, buffer.data());
+
+            auto& atlasImage = images_[rect.id];
+            atlasImage.page = page;
+            atlasImage.size = image.size;
+
+            atlasImage.texRect = glm::vec4(rect.x + Padding, rect.y + Padding, image.size.x, image.size.y) /
+                                 glm::vec4(pageSize, pageSize);
+        }
+
+        rects.erase(std::remove_if(rects.begin(), rects.end(), [](const stbrp_rect& rect)
+        {
+            return rect.was_packed;
+        }), rects.end());
+    }
+
+    for(const auto& image: images)
+    {
+        if(image.loaded)
+        {
+            stbi_image_free(const_cast<unsigned char*>(image.data));
+        }
+    }
+}
+
+} // namespace hppv
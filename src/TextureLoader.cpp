@@ -0,0 +1,175 @@
+#include <iostream>
+#include <algorithm> // std::min, std::max
+#include <cstring> // std::memcpy
+
+#include <hppv/TextureLoader.hpp>
+#include <hppv/glad.h>
+
+#include "loadImage.hpp"
+
+namespace hppv
+{
+
+TextureLoader::TextureLoader(int numThreads, const int bytesPerFrame):
+    bytesPerFrame_(bytesPerFrame)
+{
+    if(numThreads == 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for(auto i = 0; i < numThreads; ++i)
+    {
+        threads_.emplace_back(&TextureLoader::work, this);
+    }
+}
+
+TextureLoader::~TextureLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+
+    condition_.notify_all();
+
+    for(auto& thread: threads_)
+    {
+        thread.join();
+    }
+
+    for(const auto& image: images_)
+    {
+        stbi_image_free(image.data);
+    }
+
+    if(upload_)
+    {
+        stbi_image_free(upload_->image.data);
+    }
+}
+
+void TextureLoader::load(Texture& texture, const std::string& filename, const bool mipmaps)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back({&texture, filename, mipmaps});
+    }
+
+    condition_.notify_one();
+    ++numPending_;
+}
+
+void TextureLoader::update()
+{
+    auto budget = bytesPerFrame_;
+
+    while(budget > 0)
+    {
+        if(!upload_)
+        {
+            Image image;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+
+                if(images_.empty())
+                    return;
+
+                image = images_.front();
+                images_.pop_front();
+            }
+
+            if(!image.data)
+            {
+                --numPending_;
+                continue;
+            }
+
+            upload_.emplace(Upload{image, Texture(GL_RGBA8, image.size, image.mipmaps), 0});
+        }
+
+        auto& upload = *upload_;
+        const auto size = upload.image.size;
+        const auto rowBytes = size.x * 4;
+        const auto numRows = std::min(size.y - upload.row, std::max(1, budget / rowBytes));
+        const auto numBytes = numRows * rowBytes;
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos_[pboIndex_].getId());
+        pboIndex_ = (pboIndex_ + 1) % NumPbos;
+
+        // orphan the previous storage, so we don't wait for the pending transfer
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, numBytes, nullptr, GL_STREAM_DRAW);
+
+        auto* const ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, numBytes, GL_MAP_WRITE_BIT |
+                                           GL_MAP_INVALIDATE_BUFFER_BIT);
+
+        // the rows are uploaded again in the next update()
+        if(!ptr)
+        {
+            std::cout << "TextureLoader: glMapBufferRange() failed" << std::endl;
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return;
+        }
+
+        std::memcpy(ptr, upload.image.data + upload.row * rowBytes, numBytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        upload.staging.bind();
+
+        // the data is already flipped (loadImage())
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, upload.row, size.x, numRows, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        upload.row += numRows;
+        budget -= numBytes;
+
+        if(upload.row == size.y)
+        {
+            if(upload.image.mipmaps)
+            {
+                upload.staging.generateMipmaps();
+            }
+
+            *upload.image.texture = std::move(upload.staging);
+            stbi_image_free(upload.image.data);
+            upload_.reset();
+            --numPending_;
+        }
+    }
+}
+
+void TextureLoader::work()
+{
+    for(;;)
+    {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]{return quit_ || jobs_.size();});
+
+            if(quit_)
+                return;
+
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        Image image;
+        image.texture = job.texture;
+        image.mipmaps = job.mipmaps;
+        image.data = loadImage(job.filename, image.size);
+
+        if(!image.data)
+        {
+            std::cout << "TextureLoader: stbi_load() failed, filename = " << job.filename << std::endl;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        images_.push_back(image);
+    }
+}
+
+} // namespace hppv
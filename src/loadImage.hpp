@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <algorithm> // std::swap_ranges
+
+#include <glm/vec2.hpp>
+
+#include "stb_image.h"
+
+namespace hppv
+{
+
+// stbi_load() with 4 channels, the first row is the bottom one (as glTexSubImage2D() expects)
+//
+// the rows are flipped here, stbi_set_flip_vertically_on_load() is global state
+// and would race with the TextureLoader threads
+//
+// returns nullptr on failure, free the data with stbi_image_free()
+inline unsigned char* loadImage(const std::string& filename, glm::ivec2& size)
+{
+    auto* const data = stbi_load(filename.c_str(), &size.x, &size.y, nullptr, 4);
+
+    if(!data)
+        return nullptr;
+
+    const auto rowBytes = size.x * 4;
+
+    for(auto y = 0; y < size.y / 2; ++y)
+    {
+        auto* const row = data + y * rowBytes;
+        std::swap_ranges(row, row + rowBytes, data + (size.y - 1 - y) * rowBytes);
+    }
+
+    return data;
+}
+
+} // namespace hppv
@@ -9,6 +9,7 @@ layout(location = 0) in vec4 vertex;
 layout(location = 1) in vec4 color;
 layout(location = 2) in vec4 normTexRect;
 layout(location = 3) in mat4 matrix;
+layout(location = 7) in float layer;
 
 uniform mat4 projection;
 uniform bool flipTexRectX = false;
@@ -18,12 +19,14 @@ uniform bool flipTextureY = false;
 out vec4 vColor;
 out vec2 vTexCoord;
 out vec2 vPos;
+out float vLayer;
 
 void main()
 {
     gl_Position = projection * matrix * vec4(vertex.xy, 0.0, 1.0);
     vColor = color;
     vPos = vertex.xy;
+    vLayer = layer;
 
     vec2 texCoord = vertex.zw;
 
@@ -55,10 +58,24 @@ in vec4 vColor;
 in vec2 vTexCoord;
 in vec2 vPos;
 
+// compiled with (see Renderer::getShader()):
+// MODE - 0 Color, 1 Tex, 2 CircleColor, 3 CircleTex, 4 Font, 11 TexArray, 12 CircleTexArray
+// PREMULTIPLY_ALPHA, ANTIALIASED_SPRITES - optional
+
+#if MODE == 11 || MODE == 12
+
+in float vLayer;
+uniform sampler2DArray sampler;
+
+#define TEX_COORD vec3(vTexCoord, vLayer)
+
+#else
+
 uniform sampler2D sampler;
-uniform int mode = 0;
-uniform bool premultiplyAlpha = false;
-uniform bool antialiasedSprites = false;
+
+#define TEX_COORD vTexCoord
+
+#endif
 
 const float radius = 0.5;
 const vec2 center = vec2(0.5, 0.5);
@@ -85,52 +102,45 @@ float circleAlpha()
 
 void main()
 {
-    if(mode == 0) // Color
-    {
-        float alpha = 1.0;
+#if MODE == 0 // Color
 
-        if(antialiasedSprites)
-        {
-            alpha = rectAlpha();
-        }
+#ifdef ANTIALIASED_SPRITES
+    color = vColor * rectAlpha();
+#else
+    color = vColor;
+#endif
 
-        color = vColor * alpha;
-    }
-    else if(mode == 2) // CircleColor
-    {
-        color = vColor * circleAlpha();
-    }
-    else
-    {
-        vec4 sample = texture(sampler, vTexCoord);
-
-        if(mode == 4) // Font
-        {
-            color = vec4(sample.r) * vColor;
-            return;
-        }
-
-        if(premultiplyAlpha)
-        {
-            sample = vec4(sample.rgb * sample.a, sample.a);
-        }
-
-        if(mode == 1) // Tex
-        {
-            float alpha = 1.0;
-
-            if(antialiasedSprites)
-            {
-                alpha = rectAlpha();
-            }
-
-            color = sample * vColor * alpha;
-        }
-        else if(mode == 3) // CircleTex
-        {
-            color = sample * vColor * circleAlpha();
-        }
-    }
+#elif MODE == 2 // CircleColor
+
+    color = vColor * circleAlpha();
+
+#elif MODE == 4 // Font
+
+    color = vec4(texture(sampler, vTexCoord).r) * vColor;
+
+#else
+
+    vec4 sample = texture(sampler, TEX_COORD);
+
+#ifdef PREMULTIPLY_ALPHA
+    sample = vec4(sample.rgb * sample.a, sample.a);
+#endif
+
+#if MODE == 1 || MODE == 11 // Tex, TexArray
+
+#ifdef ANTIALIASED_SPRITES
+    color = sample * vColor * rectAlpha();
+#else
+    color = sample * vColor;
+#endif
+
+#elif MODE == 3 || MODE == 12 // CircleTex, CircleTexArray
+
+    color = sample * vColor * circleAlpha();
+
+#endif
+
+#endif
 }
 )";
 
@@ -143,8 +153,10 @@ in vec4 vColor;
 in vec2 vTexCoord;
 in vec2 vPos;
 
+// compiled with (see Renderer::getShader()):
+// MODE - 5 Sdf, 6 SdfOutline, 7 SdfGlow, 8 SdfShadow
+
 uniform sampler2D sampler;
-uniform int mode;
 uniform vec4 outlineColor = vec4(1.0, 0.0, 0.0, 1.0);
 uniform float outlineWidth = 0.25;                    // [0.0, 0.5]
 uniform vec4 glowColor = vec4(1.0, 0.0, 0.0, 1.0);
@@ -162,37 +174,38 @@ void main()
     float smoothing = fwidth(length(vPos - center)) * 2.0;
     float distance = texture(sampler, vTexCoord).a;
 
-    if(mode == 5) // Sdf
-    {
-        float alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
-        color = vColor * alpha;
-    }
-    else if(mode == 6) // SdfOutline
-    {
-        float outlineFactor = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
-        float oOutlineWidth = 0.5 - outlineWidth;
-        float alpha = smoothstep(oOutlineWidth - smoothing, oOutlineWidth + smoothing, distance);
-        color = mix(outlineColor, vColor, outlineFactor) * alpha;
-    }
-    else if(mode == 7) // SdfGlow
-    {
-        float glowFactor = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
-        float glowSmoothing = max(smoothing, glowWidth);
-        float alpha = smoothstep(0.5 - glowSmoothing, 0.5 + smoothing, distance);
-        color = mix(glowColor, vColor, glowFactor) * alpha;
-    }
-    else if(mode == 8) // SdfShadow
-    {
-        float alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
-        vec4 textColor = vColor * alpha;
+#if MODE == 5 // Sdf
 
-        float shadowDistance = texture(sampler, vTexCoord - vec2(shadowOffset.x, -shadowOffset.y)).a;
-        float oShadowSmoothing = max(smoothing, shadowSmoothing);
-        float shadowAlpha = smoothstep(0.5 - oShadowSmoothing, 0.5 + oShadowSmoothing, shadowDistance);
-        vec4 shadow = shadowColor * shadowAlpha;
+    float alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
+    color = vColor * alpha;
 
-        color = mix(shadow, textColor, textColor.a);
-    }
+#elif MODE == 6 // SdfOutline
+
+    float outlineFactor = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
+    float oOutlineWidth = 0.5 - outlineWidth;
+    float alpha = smoothstep(oOutlineWidth - smoothing, oOutlineWidth + smoothing, distance);
+    color = mix(outlineColor, vColor, outlineFactor) * alpha;
+
+#elif MODE == 7 // SdfGlow
+
+    float glowFactor = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
+    float glowSmoothing = max(smoothing, glowWidth);
+    float alpha = smoothstep(0.5 - glowSmoothing, 0.5 + smoothing, distance);
+    color = mix(glowColor, vColor, glowFactor) * alpha;
+
+#elif MODE == 8 // SdfShadow
+
+    float alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
+    vec4 textColor = vColor * alpha;
+
+    float shadowDistance = texture(sampler, vTexCoord - vec2(shadowOffset.x, -shadowOffset.y)).a;
+    float oShadowSmoothing = max(smoothing, shadowSmoothing);
+    float shadowAlpha = smoothstep(0.5 - oShadowSmoothing, 0.5 + oShadowSmoothing, shadowDistance);
+    vec4 shadow = shadowColor * shadowAlpha;
+
+    color = mix(shadow, textColor, textColor.a);
+
+#endif
 }
 )";
 
@@ -232,28 +245,30 @@ const char* const fVerticesSource = R"(
 in vec4 vColor;
 in vec2 vTexCoord;
 
+// compiled with (see Renderer::getShader()):
+// MODE - 9 VerticesColor, 10 VerticesTex
+// PREMULTIPLY_ALPHA - optional
+
 uniform sampler2D sampler;
-uniform int mode = 8;
-uniform bool premultiplyAlpha = false;
 
 out vec4 color;
 
 void main()
 {
-    if(mode == 9) // VerticesColor
-    {
-        color = vColor;
-    }
-    else if(mode == 10) // VerticesTex
-    {
-        vec4 sample = texture(sampler, vTexCoord);
+#if MODE == 9 // VerticesColor
 
-        if(premultiplyAlpha)
-        {
-            sample = vec4(sample.rgb * sample.a, sample.a);
-        }
+    color = vColor;
 
-        color = sample * vColor;
-    }
+#elif MODE == 10 // VerticesTex
+
+    vec4 sample = texture(sampler, vTexCoord);
+
+#ifdef PREMULTIPLY_ALPHA
+    sample = vec4(sample.rgb * sample.a, sample.a);
+#endif
+
+    color = sample * vColor;
+
+#endif
 }
 )";
@@ -0,0 +1,12 @@
+#fragment
+
+#version 330
+
+#include "cycle_b.sh"
+
+out vec4 color;
+
+void main()
+{
+    color = vec4(b, 0.0, 0.0, 1.0);
+}
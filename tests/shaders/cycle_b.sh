@@ -0,0 +1,3 @@
+#include "cycle_a.sh"
+
+const float b = 1.0;
@@ -0,0 +1,12 @@
+#fragment
+
+#version 330
+
+out vec4 color;
+
+#include "error_include.sh"
+
+void main()
+{
+    color = vec4(1.0);
+}
@@ -0,0 +1,3 @@
+// the error is on the line 3
+
+error
@@ -0,0 +1,83 @@
+#include <vector>
+#include <atomic>
+#include <numeric> // std::accumulate
+
+#include <hppv/Jobs.hpp>
+
+#include "catch.hpp"
+
+TEST_CASE("jobs parallelFor")
+{
+    hppv::Jobs jobs(4);
+    REQUIRE(jobs.getNumThreads() == 4);
+
+    std::vector<int> values(100000, 0);
+
+    jobs.parallelFor(values.size(), [&values](const int first, const int last)
+    {
+        for(auto i = first; i < last; ++i)
+        {
+            values[i] += i % 7;
+        }
+    });
+
+    auto sum = 0;
+
+    for(auto i = 0; i < int(values.size()); ++i)
+    {
+        sum += i % 7;
+    }
+
+    REQUIRE(std::accumulate(values.begin(), values.end(), 0) == sum);
+
+    // empty range
+    jobs.parallelFor(0, [](int, int) {REQUIRE(false);});
+}
+
+TEST_CASE("jobs dependencies")
+{
+    hppv::Jobs jobs(4);
+
+    std::atomic_int counter = 0;
+    int a = -1, b = -1, c = -1;
+
+    const auto idA = jobs.schedule([&]{a = counter++;});
+    const auto idB = jobs.schedule([&]{b = counter++;}, {idA});
+    const auto idC = jobs.schedule([&]{c = counter++;}, {idA, idB});
+
+    jobs.wait(idC);
+
+    REQUIRE(jobs.isDone(idA));
+    REQUIRE(jobs.isDone(idB));
+    REQUIRE(a == 0);
+    REQUIRE(b == 1);
+    REQUIRE(c == 2);
+
+    // a finished dependency
+    auto d = 0;
+    jobs.wait(jobs.schedule([&d]{d = 1;}, {idC}));
+    REQUIRE(d == 1);
+}
+
+TEST_CASE("jobs nested")
+{
+    hppv::Jobs jobs(2);
+
+    std::atomic_int count = 0;
+
+    for(auto i = 0; i < 10; ++i)
+    {
+        jobs.schedule([&jobs, &count]
+        {
+            // waiting inside a job executes the other jobs
+            jobs.parallelFor(1000, [&count](const int first, const int last)
+            {
+                count += last - first;
+            },
+            10);
+        });
+    }
+
+    jobs.waitAll();
+    REQUIRE(count == 10000);
+}
@@ -1,7 +1,16 @@
 #include <string>
+#include <map>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <thread> // std::this_thread::sleep_for
+#include <experimental/filesystem>
 
+#include <hppv/glad.h>
 #include <hppv/App.hpp>
 #include <hppv/Shader.hpp>
+#include <hppv/Deleter.hpp>
 #include <hppv/Renderer.hpp>
 
 #include "catch.hpp"
@@ -85,3 +94,231 @@ TEST_CASE("shader")
     shader2 = hppv::Shader();
     REQUIRE(shader.isValid() == false);
 }
+
+TEST_CASE("shader binary cache")
+{
+    hppv::App app;
+    REQUIRE(app.initialize({}));
+
+    namespace fs = std::experimental::filesystem;
+    const fs::path dir = "shader_cache";
+    fs::remove_all(dir);
+    hppv::Shader::setBinaryCacheDir(dir.string());
+
+    // 0 if ARB_get_program_binary is not supported, the sources are always compiled then
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    glGetError();
+
+    const auto numLoads = hppv::Shader::getNumBinaryCacheLoads();
+
+    // the first one compiles and saves the binary, the second one loads it
+    for(auto i = 0; i < 2; ++i)
+    {
+        hppv::Shader shader({vertex, fragment}, "1");
+        REQUIRE(shader.isValid());
+        shader.bind();
+
+        if(numFormats && i == 0)
+        {
+            auto numBinaries = 0;
+
+            for(const auto& entry: fs::directory_iterator(dir))
+            {
+                numBinaries += entry.path().extension() == ".bin";
+            }
+
+            REQUIRE(numBinaries == 1);
+            REQUIRE(hppv::Shader::getNumBinaryCacheLoads() == numLoads);
+        }
+    }
+
+    REQUIRE(hppv::Shader::getNumBinaryCacheLoads() == numLoads + (numFormats ? 1 : 0));
+
+    hppv::Shader shader({fragment + std::string("error")}, "2");
+    REQUIRE(shader.isValid() == false);
+
+    hppv::Shader::setBinaryCacheDir("");
+    fs::remove_all(dir);
+}
+
+// returns what was written to std::cout
+template<typename F>
+std::string captureOutput(const F& f)
+{
+    std::stringstream stream;
+    auto* const buf = std::cout.rdbuf(stream.rdbuf());
+    f();
+    std::cout.rdbuf(buf);
+    return stream.str();
+}
+
+TEST_CASE("shader include errors")
+{
+    hppv::App app;
+    REQUIRE(app.initialize({}));
+
+    // cycle_b.sh includes cycle_a.sh back, the load fails
+    {
+        hppv::Shader shader;
+
+        const auto output = captureOutput([&shader]
+        {
+            shader = hppv::Shader(hppv::Shader::File(), "shaders/cycle_a.sh");
+        });
+
+        REQUIRE(shader.isValid() == false);
+        REQUIRE(output.find("include cycle") != std::string::npos);
+    }
+
+    // source string 0 - error.sh, 1 - error_include.sh
+    {
+        hppv::Shader shader;
+
+        const auto output = captureOutput([&shader]
+        {
+            shader = hppv::Shader(hppv::Shader::File(), "shaders/error.sh");
+        });
+
+        REQUIRE(shader.isValid() == false);
+
+        // the driver formats differ, e.g. 1:3(1): error (Mesa), 1(3) : error (NVIDIA)
+        REQUIRE((output.find("1:3") != std::string::npos || output.find("1(3)") != std::string::npos));
+        REQUIRE(output.find("error_include.sh") != std::string::npos);
+    }
+}
+
+TEST_CASE("shader deferred compilation")
+{
+    hppv::App app;
+    REQUIRE(app.initialize({}));
+
+    hppv::Shader::setDeferredCompilation(true);
+
+    // global state, reset also when a REQUIRE fails
+    hppv::Deleter deleterDeferred;
+    deleterDeferred.set([]{hppv::Shader::setDeferredCompilation(false);});
+
+    hppv::Shader shader({vertex, fragment}, "1");
+    hppv::Shader shader2({fragment + std::string("error")}, "2");
+    REQUIRE(shader.isValid() == false); // pending until finishCompilation()
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+    while(hppv::Shader::getNumCompiling() && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    REQUIRE(hppv::Shader::getNumCompiling() == 0);
+    REQUIRE(shader.isReady());
+
+    shader.finishCompilation();
+    shader2.finishCompilation();
+    REQUIRE(shader.isValid());
+    REQUIRE(shader2.isValid() == false);
+}
+
+TEST_CASE("shader variants")
+{
+    hppv::App app;
+    REQUIRE(app.initialize({}));
+
+    const auto fragmentVariants = std::string(fragment) + R"(
+#ifdef ERROR
+error
+#endif
+)";
+
+    hppv::Shader shader({vertex, fragmentVariants}, "1", "#define ERROR");
+    REQUIRE(shader.isValid() == false);
+
+    hppv::ShaderVariants variants({vertex, fragmentVariants}, "2");
+    REQUIRE(variants.get("").isValid());
+    REQUIRE(variants.get("#define ERROR\n").isValid() == false);
+    REQUIRE(&variants.get("") == &variants.get(""));
+    REQUIRE(variants.getNumVariants() == 2);
+}
+
+TEST_CASE("shader uniform ids")
+{
+    hppv::App app;
+    REQUIRE(app.initialize({}));
+
+    hppv::Shader shader({hppv::Renderer::vInstancesSource, fragment}, "1");
+    REQUIRE(shader.isValid());
+
+    const auto id = shader.getUniformId("projection");
+    REQUIRE(shader.getUniformLocation(id) == shader.getUniformLocation("projection"));
+
+    const auto id2 = shader.getUniformId("inactive");
+    REQUIRE(shader.getUniformId("inactive").index == id2.index);
+    REQUIRE(shader.getUniformId("projection").index == id.index);
+}
+
+// run with: test_shader [benchmark]
+TEST_CASE("shader uniform lookup benchmark", "[.][benchmark]")
+{
+    hppv::App app;
+    REQUIRE(app.initialize({}));
+
+    std::string source = "#fragment\n#version 330\nout vec4 color;\n";
+    std::vector<std::string> names;
+
+    for(auto i = 0; i < 32; ++i)
+    {
+        names.push_back("uniform" + std::to_string(i));
+        source += "uniform float " + names.back() + ";\n";
+    }
+
+    source += "void main()\n{\ncolor = vec4(0.0);\n";
+
+    for(const auto& name: names)
+    {
+        source += "color.r += " + name + ";\n";
+    }
+
+    source += "}\n";
+
+    hppv::Shader shader({source}, "benchmark");
+    REQUIRE(shader.isValid());
+
+    // what the previous implementation used
+    std::map<std::string, GLint, std::less<>> map;
+    std::vector<hppv::Shader::UniformId> ids;
+
+    for(const auto& name: names)
+    {
+        map[name] = shader.getUniformLocation(name);
+        ids.push_back(shader.getUniformId(name));
+    }
+
+    enum {NumLookups = 1000000};
+    volatile GLint sink = 0;
+
+    BENCHMARK("std::map, 1M lookups")
+    {
+        for(auto i = 0; i < NumLookups; ++i)
+        {
+            sink = map.find(names[i % names.size()])->second;
+        }
+    }
+
+    BENCHMARK("Shader::getUniformLocation(name), 1M lookups")
+    {
+        for(auto i = 0; i < NumLookups; ++i)
+        {
+            sink = shader.getUniformLocation(names[i % names.size()]);
+        }
+    }
+
+    BENCHMARK("Shader::getUniformLocation(UniformId), 1M lookups")
+    {
+        for(auto i = 0; i < NumLookups; ++i)
+        {
+            sink = shader.getUniformLocation(ids[i % ids.size()]);
+        }
+    }
+
+    static_cast<void>(sink);
+}
@@ -0,0 +1,4 @@
+// texpack doesn't link hppv (no GL, GLFW or imgui on the asset machines),
+// so it compiles its own stb_image
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
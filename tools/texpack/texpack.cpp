@@ -0,0 +1,354 @@
+// converts an image into the *.hptx container (see hppv/TextureFile.hpp)
+//
+// usage: texpack [--bc] [--no-mipmaps] input output.hptx
+//
+// --bc - BC1 (opaque images) or BC3 compression, requires
+//        EXT_texture_compression_s3tc at runtime
+//
+// without --bc the images with r == g == b are stored as Gray8 / GrayAlpha8
+
+#include <cstdint>
+#include <cstring> // std::strcmp, std::memcpy
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm> // std::min, std::max
+
+#include <hppv/TextureFile.hpp>
+
+#include "stb_image.h"
+
+using namespace hppv;
+
+struct Image
+{
+    int sizeX, sizeY;
+    std::vector<unsigned char> pixels; // rgba
+};
+
+// 2x2 box filter
+Image downsample(const Image& src)
+{
+    Image dst;
+    dst.sizeX = std::max(1, src.sizeX / 2);
+    dst.sizeY = std::max(1, src.sizeY / 2);
+    dst.pixels.resize(dst.sizeX * dst.sizeY * 4);
+
+    for(auto y = 0; y < dst.sizeY; ++y)
+    {
+        for(auto x = 0; x < dst.sizeX; ++x)
+        {
+            const int x0 = std::min(x * 2, src.sizeX - 1);
+            const int x1 = std::min(x * 2 + 1, src.sizeX - 1);
+            const int y0 = std::min(y * 2, src.sizeY - 1);
+            const int y1 = std::min(y * 2 + 1, src.sizeY - 1);
+
+            for(auto c = 0; c < 4; ++c)
+            {
+                const auto sum = src.pixels[(y0 * src.sizeX + x0) * 4 + c] +
+                                 src.pixels[(y0 * src.sizeX + x1) * 4 + c] +
+                                 src.pixels[(y1 * src.sizeX + x0) * 4 + c] +
+                                 src.pixels[(y1 * src.sizeX + x1) * 4 + c];
+
+                dst.pixels[(y * dst.sizeX + x) * 4 + c] = (sum + 2) / 4;
+            }
+        }
+    }
+
+    return dst;
+}
+
+std::uint16_t toRgb565(const int r, const int g, const int b)
+{
+    return ((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255);
+}
+
+void fromRgb565(const std::uint16_t c, int* const rgb)
+{
+    rgb[0] = ((c >> 11) & 31) * 255 / 31;
+    rgb[1] = ((c >> 5) & 63) * 255 / 63;
+    rgb[2] = (c & 31) * 255 / 31;
+}
+
+template<typename T>
+void append(std::vector<unsigned char>& out, const T value)
+{
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// range fit - the endpoints are the corners of the bounding box,
+// always the four color mode
+
+void encodeColorBlock(const unsigned char* const block, std::vector<unsigned char>& out)
+{
+    int min[3] = {255, 255, 255}, max[3] = {0, 0, 0};
+
+    for(auto i = 0; i < 16; ++i)
+    {
+        for(auto c = 0; c < 3; ++c)
+        {
+            min[c] = std::min(min[c], int(block[i * 4 + c]));
+            max[c] = std::max(max[c], int(block[i * 4 + c]));
+        }
+    }
+
+    auto c0 = toRgb565(max[0], max[1], max[2]);
+    auto c1 = toRgb565(min[0], min[1], min[2]);
+
+    if(c0 < c1)
+        std::swap(c0, c1);
+
+    std::uint32_t indices = 0;
+
+    if(c0 != c1)
+    {
+        int palette[4][3];
+        fromRgb565(c0, palette[0]);
+        fromRgb565(c1, palette[1]);
+
+        for(auto c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for(auto i = 0; i < 16; ++i)
+        {
+            auto best = 0, bestDist = 1 << 30;
+
+            for(auto p = 0; p < 4; ++p)
+            {
+                auto dist = 0;
+
+                for(auto c = 0; c < 3; ++c)
+                {
+                    const auto d = block[i * 4 + c] - palette[p][c];
+                    dist += d * d;
+                }
+
+                if(dist < bestDist)
+                {
+                    bestDist = dist;
+                    best = p;
+                }
+            }
+
+            indices |= std::uint32_t(best) << (i * 2);
+        }
+    }
+
+    append(out, c0);
+    append(out, c1);
+    append(out, indices);
+}
+
+// the eight value mode (a0 > a1)
+
+void encodeAlphaBlock(const unsigned char* const block, std::vector<unsigned char>& out)
+{
+    auto min = 255, max = 0;
+
+    for(auto i = 0; i < 16; ++i)
+    {
+        min = std::min(min, int(block[i * 4 + 3]));
+        max = std::max(max, int(block[i * 4 + 3]));
+    }
+
+    std::uint64_t indices = 0;
+
+    if(min != max)
+    {
+        int palette[8] = {max, min};
+
+        for(auto p = 1; p < 7; ++p)
+            palette[p + 1] = ((7 - p) * max + p * min) / 7;
+
+        for(auto i = 0; i < 16; ++i)
+        {
+            auto best = 0, bestDist = 256;
+
+            for(auto p = 0; p < 8; ++p)
+            {
+                const auto dist = std::abs(block[i * 4 + 3] - palette[p]);
+
+                if(dist < bestDist)
+                {
+                    bestDist = dist;
+                    best = p;
+                }
+            }
+
+            indices |= std::uint64_t(best) << (i * 3);
+        }
+    }
+
+    out.push_back(max);
+    out.push_back(min);
+
+    for(auto i = 0; i < 6; ++i)
+        out.push_back((indices >> (i * 8)) & 255);
+}
+
+std::vector<unsigned char> compress(const Image& image, const bool alpha)
+{
+    std::vector<unsigned char> out;
+
+    for(auto by = 0; by < image.sizeY; by += 4)
+    {
+        for(auto bx = 0; bx < image.sizeX; bx += 4)
+        {
+            // the edge pixels are repeated for the incomplete blocks
+            unsigned char block[16 * 4];
+
+            for(auto y = 0; y < 4; ++y)
+            {
+                for(auto x = 0; x < 4; ++x)
+                {
+                    const auto srcX = std::min(bx + x, image.sizeX - 1);
+                    const auto srcY = std::min(by + y, image.sizeY - 1);
+                    std::memcpy(block + (y * 4 + x) * 4, &image.pixels[(srcY * image.sizeX + srcX) * 4], 4);
+                }
+            }
+
+            if(alpha)
+                encodeAlphaBlock(block, out);
+
+            encodeColorBlock(block, out);
+        }
+    }
+
+    return out;
+}
+
+std::vector<unsigned char> convert(const Image& image, const hptx::Format format)
+{
+    switch(format)
+    {
+    case hptx::Format::Bc1: return compress(image, false);
+    case hptx::Format::Bc3: return compress(image, true);
+    case hptx::Format::Rgba8: return image.pixels;
+    default: break;
+    }
+
+    const auto numChannels = format == hptx::Format::Gray8 ? 1 : 2;
+    std::vector<unsigned char> out;
+    out.reserve(image.sizeX * image.sizeY * numChannels);
+
+    for(auto i = 0; i < image.sizeX * image.sizeY; ++i)
+    {
+        out.push_back(image.pixels[i * 4]);
+
+        if(numChannels == 2)
+            out.push_back(image.pixels[i * 4 + 3]);
+    }
+
+    return out;
+}
+
+int main(int argc, const char* const* argv)
+{
+    auto bc = false;
+    auto mipmaps = true;
+    std::vector<std::string> files;
+
+    for(auto i = 1; i < argc; ++i)
+    {
+        if(std::strcmp(argv[i], "--bc") == 0)
+            bc = true;
+        else if(std::strcmp(argv[i], "--no-mipmaps") == 0)
+            mipmaps = false;
+        else
+            files.push_back(argv[i]);
+    }
+
+    if(files.size() != 2)
+    {
+        std::cout << "usage: texpack [--bc] [--no-mipmaps] input output.hptx" << std::endl;
+        return 1;
+    }
+
+    Image image;
+
+    {
+        // OpenGL row order
+        stbi_set_flip_vertically_on_load(true);
+
+        auto* const data = stbi_load(files[0].c_str(), &image.sizeX, &image.sizeY, nullptr, 4);
+
+        if(!data)
+        {
+            std::cout << "stbi_load() failed, filename = " << files[0] << std::endl;
+            return 1;
+        }
+
+        image.pixels.assign(data, data + image.sizeX * image.sizeY * 4);
+        stbi_image_free(data);
+    }
+
+    auto gray = true, opaque = true;
+
+    for(auto i = 0; i < image.sizeX * image.sizeY; ++i)
+    {
+        const auto* const p = &image.pixels[i * 4];
+        gray = gray && p[0] == p[1] && p[1] == p[2];
+        opaque = opaque && p[3] == 255;
+    }
+
+    hptx::Format format;
+
+    if(bc)
+        format = opaque ? hptx::Format::Bc1 : hptx::Format::Bc3;
+    else if(gray)
+        format = opaque ? hptx::Format::Gray8 : hptx::Format::GrayAlpha8;
+    else
+        format = hptx::Format::Rgba8;
+
+    hptx::Header header;
+    std::memcpy(header.magic, "HPTX", 4);
+    header.version = hptx::Version;
+    header.format = format;
+    header.sizeX = image.sizeX;
+    header.sizeY = image.sizeY;
+
+    std::vector<std::vector<unsigned char>> levels;
+    levels.push_back(convert(image, format));
+
+    while(mipmaps && (image.sizeX > 1 || image.sizeY > 1))
+    {
+        image = downsample(image);
+        levels.push_back(convert(image, format));
+    }
+
+    header.numLevels = levels.size();
+
+    std::vector<unsigned char> out;
+    append(out, header);
+
+    auto offset = sizeof(hptx::Header) + levels.size() * sizeof(hptx::Level);
+
+    for(const auto& level: levels)
+    {
+        offset = (offset + 3) / 4 * 4;
+        append(out, hptx::Level{std::uint32_t(offset), std::uint32_t(level.size())});
+        offset += level.size();
+    }
+
+    for(const auto& level: levels)
+    {
+        out.resize((out.size() + 3) / 4 * 4, 0);
+        out.insert(out.end(), level.begin(), level.end());
+    }
+
+    std::ofstream file(files[1], std::ios::binary);
+
+    if(!file.write(reinterpret_cast<const char*>(out.data()), out.size()))
+    {
+        std::cout << "could not write, filename = " << files[1] << std::endl;
+        return 1;
+    }
+
+    return 0;
+}